@@ -0,0 +1,120 @@
+#include "barcode-cache.h"
+
+
+typedef struct
+{
+	const gchar* format;	// interned
+	gchar* text;
+	GstClockTime lastSeen;
+	GList link;				// node in the LRU list, most recent at the head
+} BarcodeCacheEntry;
+
+struct _BarcodeCache
+{
+	GHashTable* pEntries;
+	GQueue lru;
+	guint uCapacity;
+};
+
+
+static guint barcode_cache_entry_hash(gconstpointer key)
+{
+	const BarcodeCacheEntry* entry = (const BarcodeCacheEntry*)key;
+
+	return g_str_hash(entry->text) ^ g_direct_hash(entry->format);
+}
+
+static gboolean barcode_cache_entry_equal(gconstpointer a, gconstpointer b)
+{
+	const BarcodeCacheEntry* ea = (const BarcodeCacheEntry*)a;
+	const BarcodeCacheEntry* eb = (const BarcodeCacheEntry*)b;
+
+	return ea->format == eb->format && g_str_equal(ea->text, eb->text);
+}
+
+static void barcode_cache_entry_free(gpointer data)
+{
+	BarcodeCacheEntry* entry = (BarcodeCacheEntry*)data;
+
+	g_free(entry->text);
+	g_free(entry);
+}
+
+static void barcode_cache_evict(BarcodeCache* cache)
+{
+	while (g_queue_get_length(&cache->lru) > cache->uCapacity)
+	{
+		GList* link = g_queue_peek_tail_link(&cache->lru);
+		BarcodeCacheEntry* entry = (BarcodeCacheEntry*)link->data;
+
+		g_queue_unlink(&cache->lru, link);
+		g_hash_table_remove(cache->pEntries, entry);
+	}
+}
+
+BarcodeCache* barcode_cache_new(guint capacity)
+{
+	BarcodeCache* cache = g_new0(BarcodeCache, 1);
+
+	cache->pEntries = g_hash_table_new_full(barcode_cache_entry_hash, barcode_cache_entry_equal, barcode_cache_entry_free, NULL);
+	g_queue_init(&cache->lru);
+	cache->uCapacity = MAX(capacity, 1);
+
+	return cache;
+}
+
+void barcode_cache_free(BarcodeCache* cache)
+{
+	g_hash_table_unref(cache->pEntries);
+	g_free(cache);
+}
+
+void barcode_cache_set_capacity(BarcodeCache* cache, guint capacity)
+{
+	cache->uCapacity = MAX(capacity, 1);
+	barcode_cache_evict(cache);
+}
+
+void barcode_cache_clear(BarcodeCache* cache)
+{
+	// the list nodes live inside the entries, so only reset the queue
+	g_queue_init(&cache->lru);
+	g_hash_table_remove_all(cache->pEntries);
+}
+
+gboolean barcode_cache_check(BarcodeCache* cache, const gchar* format, const gchar* text, GstClockTime now, GstClockTime ttl)
+{
+	BarcodeCacheEntry key;
+	BarcodeCacheEntry* entry;
+	gboolean bNew;
+
+	key.format = g_intern_string(format);
+	key.text = (gchar*)text;
+
+	entry = (BarcodeCacheEntry*)g_hash_table_lookup(cache->pEntries, &key);
+
+	if (entry)
+	{
+		// a timestamp going backwards means the stream was seeked or restarted
+		bNew = now < entry->lastSeen || now - entry->lastSeen >= ttl;
+
+		g_queue_unlink(&cache->lru, &entry->link);
+	}
+	else
+	{
+		entry = g_new0(BarcodeCacheEntry, 1);
+		entry->format = key.format;
+		entry->text = g_strdup(text);
+		entry->link.data = entry;
+		g_hash_table_add(cache->pEntries, entry);
+
+		bNew = TRUE;
+	}
+
+	entry->lastSeen = now;
+	g_queue_push_head_link(&cache->lru, &entry->link);
+
+	barcode_cache_evict(cache);
+
+	return bNew;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <gst/gst.h>
+
+
+typedef struct _BarcodeCache BarcodeCache;
+
+// remembers recently seen (format, text) pairs, least recently seen entries
+// are evicted once the cache holds more than capacity codes
+BarcodeCache* barcode_cache_new(guint capacity);
+void barcode_cache_free(BarcodeCache* cache);
+void barcode_cache_set_capacity(BarcodeCache* cache, guint capacity);
+void barcode_cache_clear(BarcodeCache* cache);
+
+// records a sighting at now, returns TRUE when the code was not seen within ttl
+gboolean barcode_cache_check(BarcodeCache* cache, const gchar* format, const gchar* text, GstClockTime now, GstClockTime ttl);
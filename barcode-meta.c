@@ -0,0 +1,103 @@
+#include "barcode-meta.h"
+
+
+void gst_barcode_meta_entry_clear(gpointer data)
+{
+	GstBarcodeMetaEntry* entry = (GstBarcodeMetaEntry*)data;
+
+	g_free(entry->text);
+}
+
+static gboolean gst_barcode_meta_init(GstMeta* meta, gpointer params, GstBuffer* buffer)
+{
+	GstBarcodeMeta* bmeta = (GstBarcodeMeta*)meta;
+
+	bmeta->pts = GST_CLOCK_TIME_NONE;
+	bmeta->barcodes = g_array_new(FALSE, FALSE, sizeof(GstBarcodeMetaEntry));
+	g_array_set_clear_func(bmeta->barcodes, gst_barcode_meta_entry_clear);
+
+	return TRUE;
+}
+
+static void gst_barcode_meta_free(GstMeta* meta, GstBuffer* buffer)
+{
+	GstBarcodeMeta* bmeta = (GstBarcodeMeta*)meta;
+
+	g_array_unref(bmeta->barcodes);
+}
+
+static gboolean gst_barcode_meta_transform(GstBuffer* dest, GstMeta* meta, GstBuffer* buffer, GQuark type, gpointer data)
+{
+	GstBarcodeMeta* smeta = (GstBarcodeMeta*)meta;
+	GstBarcodeMeta* dmeta;
+
+	// positions are in frame coordinates, only plain copies keep them valid
+	if (!GST_META_TRANSFORM_IS_COPY(type))
+		return FALSE;
+
+	dmeta = gst_buffer_add_barcode_meta(dest, smeta->pts);
+	if (!dmeta)
+		return FALSE;
+
+	for (guint i = 0; i < smeta->barcodes->len; i++)
+	{
+		GstBarcodeMetaEntry* entry = &g_array_index(smeta->barcodes, GstBarcodeMetaEntry, i);
+		gst_barcode_meta_add_barcode(dmeta, entry->text, entry->format, entry->position);
+	}
+
+	return TRUE;
+}
+
+GType gst_barcode_meta_api_get_type(void)
+{
+	static GType type = 0;
+	static const gchar* tags[] = { GST_META_TAG_VIDEO_STR, NULL };
+
+	if (g_once_init_enter(&type))
+	{
+		GType _type = gst_meta_api_type_register("GstBarcodeMetaAPI", tags);
+		g_once_init_leave(&type, _type);
+	}
+
+	return type;
+}
+
+const GstMetaInfo* gst_barcode_meta_get_info(void)
+{
+	static const GstMetaInfo* meta_info = NULL;
+
+	if (g_once_init_enter((GstMetaInfo**)&meta_info))
+	{
+		const GstMetaInfo* mi = gst_meta_register(
+			GST_BARCODE_META_API_TYPE,
+			"GstBarcodeMeta",
+			sizeof(GstBarcodeMeta),
+			gst_barcode_meta_init,
+			gst_barcode_meta_free,
+			gst_barcode_meta_transform);
+		g_once_init_leave((GstMetaInfo**)&meta_info, (GstMetaInfo*)mi);
+	}
+
+	return meta_info;
+}
+
+GstBarcodeMeta* gst_buffer_add_barcode_meta(GstBuffer* buffer, GstClockTime pts)
+{
+	GstBarcodeMeta* meta = (GstBarcodeMeta*)gst_buffer_add_meta(buffer, GST_BARCODE_META_INFO, NULL);
+
+	if (meta)
+		meta->pts = pts;
+
+	return meta;
+}
+
+void gst_barcode_meta_add_barcode(GstBarcodeMeta* meta, const gchar* text, const gchar* format, ZXing_Position position)
+{
+	GstBarcodeMetaEntry entry;
+
+	entry.text = g_strdup(text);
+	entry.format = g_intern_string(format);
+	entry.position = position;
+
+	g_array_append_val(meta->barcodes, entry);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <ZXing/ZXingC.h>
+
+
+G_BEGIN_DECLS
+
+#define GST_BARCODE_META_API_TYPE (gst_barcode_meta_api_get_type())
+#define GST_BARCODE_META_INFO (gst_barcode_meta_get_info())
+
+typedef struct _GstBarcodeMeta GstBarcodeMeta;
+
+/**
+ * GstBarcodeMetaEntry:
+ * @text: decoded text
+ * @format: interned barcode format name
+ * @position: corners of the barcode in frame coordinates
+ */
+typedef struct
+{
+	gchar* text;
+	const gchar* format;
+	ZXing_Position position;
+} GstBarcodeMetaEntry;
+
+/**
+ * GstBarcodeMeta:
+ * @meta: parent #GstMeta
+ * @pts: PTS of the frame the barcodes were decoded from. Differs from the
+ *   buffer PTS when the reader decodes asynchronously
+ * @barcodes: #GArray of #GstBarcodeMetaEntry
+ */
+struct _GstBarcodeMeta
+{
+	GstMeta meta;
+
+	GstClockTime pts;
+	GArray* barcodes;
+};
+
+GType gst_barcode_meta_api_get_type(void);
+const GstMetaInfo* gst_barcode_meta_get_info(void);
+
+#define gst_buffer_get_barcode_meta(b) \
+  ((GstBarcodeMeta*)gst_buffer_get_meta((b), GST_BARCODE_META_API_TYPE))
+
+void gst_barcode_meta_entry_clear(gpointer entry);
+
+GstBarcodeMeta* gst_buffer_add_barcode_meta(GstBuffer* buffer, GstClockTime pts);
+void gst_barcode_meta_add_barcode(GstBarcodeMeta* meta, const gchar* text, const gchar* format, ZXing_Position position);
+
+G_END_DECLS
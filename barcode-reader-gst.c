@@ -1,12 +1,18 @@
 #include <gst/video/video.h>
 
 #include "barcode-reader-gst.h"
-#include "utils.h"
+#include "barcode-meta.h"
 
 
 GST_DEBUG_CATEGORY_STATIC (barcodereader_debug);
 #define GST_CAT_DEFAULT (barcodereader_debug)
 
+#define TRACKER_MAX_MISSES 3
+#define CANDIDATE_MIN_MARGIN 16
+#define DECODE_COST_WEIGHT 0.2		// weight of the latest decode in the cost average
+#define MAX_SPARE_JOBS 8
+#define DECODE_COST_DECAY 0.9		// lets a skipping reader probe again eventually
+
 enum
 {
 	PROP_0,
@@ -15,6 +21,47 @@ enum
 	PROP_SHOW_LOCATION,
 	PROP_COI_START_X,
 	PROP_COI_WIDTH,
+	PROP_ASYNC_DECODE,
+	PROP_QUEUE_POLICY,
+	PROP_MAX_QUEUED_FRAMES,
+	PROP_DECODE_THREADS,
+	PROP_DECODE_INTERVAL,
+	PROP_MAX_DECODE_FPS,
+	PROP_ADAPTIVE_DECODE,
+	PROP_ADAPTIVE_MAX_INTERVAL,
+	PROP_ADAPTIVE_IDLE_FRAMES,
+	PROP_ATTACH_META,
+	PROP_ATTACH_ROI_META,
+	PROP_EMIT_SIGNALS,
+	PROP_POST_MESSAGES,
+	PROP_MESSAGE_BATCH_FRAMES,
+	PROP_MESSAGE_BATCH_TIME,
+	PROP_DEDUP_TTL,
+	PROP_DEDUP_CAPACITY,
+	PROP_ROI_LIST,
+	PROP_USE_ROI_META,
+	PROP_PARALLEL_ROI,
+	PROP_MOTION_THRESHOLD,
+	PROP_MOTION_RESTRICT,
+	PROP_TRACKING,
+	PROP_TRACKING_FULL_SCAN_INTERVAL,
+	PROP_PYRAMID_FACTOR,
+	PROP_MAX_CANDIDATES,
+	PROP_PYRAMID_FULL_SCAN_INTERVAL,
+	PROP_PRESET,
+	PROP_TRY_HARDER,
+	PROP_TRY_ROTATE,
+	PROP_TRY_INVERT,
+	PROP_TRY_DOWNSCALE,
+	PROP_BINARIZER,
+	PROP_IS_PURE,
+	PROP_MIN_LINE_COUNT,
+	PROP_MAX_NUMBER_OF_SYMBOLS,
+	PROP_ADAPTIVE_EFFORT,
+	PROP_EFFORT_BUDGET,
+	PROP_MAX_DECODE_LATENCY,
+	PROP_OVERLAY_THICKNESS,
+	PROP_OVERLAY_FILL_ALPHA,
 	PROP_LAST
 };
 
@@ -31,7 +78,8 @@ GST_ELEMENT_REGISTER_DEFINE (barcodereader, "barcodereader",
     GST_RANK_NONE, gst_barcode_reader_get_type ());
 
 #define CAPS_STR GST_VIDEO_CAPS_MAKE ("{ " \
-    "ARGB, BGRA, ABGR, RGBA, xRGB, BGRx, xBGR, RGBx, RGB, BGR, YUY2, NV12, NV21, I420, YV12, GRAY8 }")
+    "ARGB, BGRA, ABGR, RGBA, xRGB, BGRx, xBGR, RGBx, RGB, BGR, YUY2, UYVY, NV12, NV21, NV16, I420, YV12, GRAY8, " \
+    "GRAY16_LE, GRAY16_BE, P010_10LE, v210 }")
 
 static GstStaticPadTemplate gst_barcode_reader_src_template =
 GST_STATIC_PAD_TEMPLATE ("src",
@@ -47,18 +95,189 @@ GST_STATIC_PAD_TEMPLATE ("sink",
     GST_STATIC_CAPS (CAPS_STR)
     );
 
-static ZXing_ReaderOptions* gst_barcode_reader_new_zxing_opts(GstBarcodeReader* filter)
+// decode settings of a frame, queued frames keep the ones they were submitted with
+typedef struct
+{
+	ZXing_ImageFormat eImageFormat;
+	DecodePool* pPool;			// set when regions are decoded in parallel
+	guint uPyramidFactor;
+	guint uMaxCandidates;
+	gboolean bPyramidFullScan;	// decode the whole regions when the pyramid pass finds nothing
+	gboolean bAdaptiveEffort;
+	GstClockTime effortBudget;
+} GstBarcodeReaderDecodeParams;
+
+// the pixels ZXing reads, either straight out of the mapped frame or out of a luma copy
+typedef struct
 {
-	if (filter->pOpts)
-		ZXing_ReaderOptions_delete(filter->pOpts);
+	const guint8* pData;
+	gint width;
+	gint height;
+	gint rowStride;
+	gint pixStride;
+	ZXing_ImageFormat eFormat;
+} GstBarcodeReaderImage;
 
-	filter->pOpts = ZXing_ReaderOptions_new();
+typedef struct _GstBarcodeReaderJob GstBarcodeReaderJob;
 
-	ZXing_ReaderOptions_setTextMode(filter->pOpts, ZXing_TextMode_HRI);
-	ZXing_ReaderOptions_setEanAddOnSymbol(filter->pOpts, ZXing_EanAddOnSymbol_Ignore);
-	ZXing_ReaderOptions_setFormats(filter->pOpts, filter->uBarcodeFormats);
-	
-	return filter->pOpts;
+struct _GstBarcodeReaderJob
+{
+	GstBarcodeReader* filter;
+	GstBarcodeReaderJob* pNext;		// in the list of spare jobs
+	GList link;						// in the decode queue
+	GstBuffer* pBuffer;				// NULL when decoding the copy in luma
+	GstVideoInfo info;
+	LumaPlane luma;					// regions of a frame the overlay is drawn into
+	GstBarcodeReaderImage image;
+	GstBarcodeReaderDecodeParams params;
+	GstBarcodeReaderConfig* pConfig;
+	GArray* pRegions;
+	GstClockTime pts;
+	GstClockTime runningTime;
+	guint uFlushSeq;
+};
+
+typedef struct
+{
+	const GstBarcodeReaderConfig* pConfig;
+	const GstBarcodeReaderImage* pImage;
+	const GstBarcodeReaderDecodeParams* pParams;
+	gint64 startTime;
+	const GstBarcodeReaderRegion* pRegions;
+	gpointer* ppBarcodes;
+} GstBarcodeReaderDecodeTask;
+
+static void gst_barcode_reader_apply_preset(GstBarcodeReader* filter, GstBarcodeReaderPreset ePreset)
+{
+	filter->ePreset = ePreset;
+
+	switch (ePreset)
+	{
+	case GST_BARCODE_READER_PRESET_FAST:
+		filter->bTryHarder = FALSE;
+		filter->bTryRotate = FALSE;
+		filter->bTryInvert = FALSE;
+		filter->bTryDownscale = FALSE;
+		break;
+
+	case GST_BARCODE_READER_PRESET_BALANCED:
+		filter->bTryHarder = FALSE;
+		filter->bTryRotate = TRUE;
+		filter->bTryInvert = FALSE;
+		filter->bTryDownscale = TRUE;
+		break;
+
+	case GST_BARCODE_READER_PRESET_THOROUGH:
+		filter->bTryHarder = TRUE;
+		filter->bTryRotate = TRUE;
+		filter->bTryInvert = TRUE;
+		filter->bTryDownscale = TRUE;
+		break;
+
+	default:
+		break;
+	}
+}
+
+static ZXing_ReaderOptions* gst_barcode_reader_create_zxing_opts(GstBarcodeReader* filter)
+{
+	ZXing_ReaderOptions* pOpts = ZXing_ReaderOptions_new();
+
+	ZXing_ReaderOptions_setTextMode(pOpts, ZXing_TextMode_HRI);
+	ZXing_ReaderOptions_setEanAddOnSymbol(pOpts, ZXing_EanAddOnSymbol_Ignore);
+	ZXing_ReaderOptions_setFormats(pOpts, filter->uBarcodeFormats);
+	ZXing_ReaderOptions_setTryHarder(pOpts, filter->bTryHarder);
+	ZXing_ReaderOptions_setTryRotate(pOpts, filter->bTryRotate);
+	ZXing_ReaderOptions_setTryInvert(pOpts, filter->bTryInvert);
+	ZXing_ReaderOptions_setTryDownscale(pOpts, filter->bTryDownscale);
+	ZXing_ReaderOptions_setBinarizer(pOpts, filter->eBinarizer);
+	ZXing_ReaderOptions_setIsPure(pOpts, filter->bIsPure);
+	ZXing_ReaderOptions_setMinLineCount(pOpts, filter->iMinLineCount);
+	ZXing_ReaderOptions_setMaxNumberOfSymbols(pOpts, filter->iMaxNumberOfSymbols);
+
+	return pOpts;
+}
+
+static GstBarcodeReaderConfig* gst_barcode_reader_config_ref(GstBarcodeReaderConfig* pConfig)
+{
+	g_atomic_int_inc(&pConfig->refCount);
+
+	return pConfig;
+}
+
+static void gst_barcode_reader_config_unref(GstBarcodeReaderConfig* pConfig)
+{
+	if (!g_atomic_int_dec_and_test(&pConfig->refCount))
+		return;
+
+	ZXing_ReaderOptions_delete(pConfig->pOpts);
+	ZXing_ReaderOptions_delete(pConfig->pDetectOpts);
+	ZXing_ReaderOptions_delete(pConfig->pCheapOpts);
+	g_free(pConfig);
+}
+
+// must be called with the object lock held, publishes a new snapshot of the
+// ZXing settings. Decodes in flight keep the one they started with
+static void gst_barcode_reader_update_config(GstBarcodeReader* filter)
+{
+	GstBarcodeReaderConfig* pConfig = g_new0(GstBarcodeReaderConfig, 1);
+	GstBarcodeReaderConfig* pOld;
+
+	pConfig->refCount = 1;
+	pConfig->pOpts = gst_barcode_reader_create_zxing_opts(filter);
+
+	// the pyramid pass only needs to know where codes are, not what they say
+	pConfig->pDetectOpts = gst_barcode_reader_create_zxing_opts(filter);
+
+	ZXing_ReaderOptions_setTryDownscale(pConfig->pDetectOpts, FALSE);
+	ZXing_ReaderOptions_setReturnErrors(pConfig->pDetectOpts, TRUE);
+
+	// first pass of adaptive effort, a result that fails to decode is the hint to try harder
+	pConfig->pCheapOpts = gst_barcode_reader_create_zxing_opts(filter);
+
+	ZXing_ReaderOptions_setTryHarder(pConfig->pCheapOpts, FALSE);
+	ZXing_ReaderOptions_setTryRotate(pConfig->pCheapOpts, FALSE);
+	ZXing_ReaderOptions_setTryInvert(pConfig->pCheapOpts, FALSE);
+	ZXing_ReaderOptions_setTryDownscale(pConfig->pCheapOpts, TRUE);
+	ZXing_ReaderOptions_setReturnErrors(pConfig->pCheapOpts, TRUE);
+
+	g_mutex_lock(&filter->configLock);
+	pOld = filter->pConfig;
+	filter->pConfig = pConfig;
+	g_mutex_unlock(&filter->configLock);
+
+	if (pOld)
+		gst_barcode_reader_config_unref(pOld);
+}
+
+// returns a reference to the current snapshot, configLock is only held for the pointer read
+static GstBarcodeReaderConfig* gst_barcode_reader_get_config(GstBarcodeReader* filter)
+{
+	g_mutex_lock(&filter->configLock);
+	GstBarcodeReaderConfig* pConfig = gst_barcode_reader_config_ref(filter->pConfig);
+	g_mutex_unlock(&filter->configLock);
+
+	return pConfig;
+}
+
+// must be called with the object lock held
+static gboolean gst_barcode_reader_draws_overlay(GstBarcodeReader* filter)
+{
+	if (!filter->bEnableReader || filter->uBarcodeFormats == 0)
+		return FALSE;
+
+	return filter->bShowLocation || filter->pRegions->len > 0
+		|| filter->uCoiStartX > 0 || (filter->uCoiWidth > 0 && filter->uCoiWidth != filter->width);
+}
+
+// analysis only: without overlays the buffer is never made writable or copied
+static void gst_barcode_reader_update_passthrough(GstBarcodeReader* filter)
+{
+	GST_OBJECT_LOCK(filter);
+	gboolean bPassthrough = !gst_barcode_reader_draws_overlay(filter);
+	GST_OBJECT_UNLOCK(filter);
+
+	gst_base_transform_set_passthrough(GST_BASE_TRANSFORM(filter), bPassthrough);
 }
 
 static gboolean gst_barcode_reader_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
@@ -74,7 +293,9 @@ static gboolean gst_barcode_reader_set_info (GstVideoFilter * vfilter, GstCaps *
 	filter->format = GST_VIDEO_INFO_FORMAT(in_info);
 	filter->width = GST_VIDEO_INFO_WIDTH(in_info);
 	filter->height = GST_VIDEO_INFO_HEIGHT(in_info);
-	filter->pOpts = gst_barcode_reader_new_zxing_opts(filter);
+	filter->frameDuration = GST_VIDEO_INFO_FPS_N(in_info) > 0 && GST_VIDEO_INFO_FPS_D(in_info) > 0
+		? gst_util_uint64_scale_int(GST_SECOND, GST_VIDEO_INFO_FPS_D(in_info), GST_VIDEO_INFO_FPS_N(in_info)) : 0;
+	gst_barcode_reader_update_config(filter);
 	
 	switch (filter->format)
 	{
@@ -107,14 +328,17 @@ static gboolean gst_barcode_reader_set_info (GstVideoFilter * vfilter, GstCaps *
 		break;
 	
 	case GST_VIDEO_FORMAT_YUY2:
-		filter->eImageFormat = ZXing_ImageFormat_LumA;
-		break;
-
+	case GST_VIDEO_FORMAT_UYVY:
 	case GST_VIDEO_FORMAT_NV12:
 	case GST_VIDEO_FORMAT_NV21:
+	case GST_VIDEO_FORMAT_NV16:
 	case GST_VIDEO_FORMAT_YV12:
 	case GST_VIDEO_FORMAT_I420:
 	case GST_VIDEO_FORMAT_GRAY8:
+	case GST_VIDEO_FORMAT_GRAY16_LE:
+	case GST_VIDEO_FORMAT_GRAY16_BE:
+	case GST_VIDEO_FORMAT_P010_10LE:
+	case GST_VIDEO_FORMAT_v210:
 		filter->eImageFormat = ZXing_ImageFormat_Lum;
 		break;
 
@@ -122,306 +346,1974 @@ static gboolean gst_barcode_reader_set_info (GstVideoFilter * vfilter, GstCaps *
 		break;
 	}
 
-	utils_init(filter->format);
+	// v210 and the RGB formats are read through a luma copy, sized once per caps
+	gboolean bLumaCopy = filter->format == GST_VIDEO_FORMAT_v210
+		|| (filter->eImageFormat != ZXing_ImageFormat_None && filter->eImageFormat != ZXing_ImageFormat_Lum);
+	gint width = filter->width;
+	gint height = filter->height;
+
+	overlay_set_format(filter->pOverlay, filter->format);
+	motion_gate_reset(filter->pMotionGate);
+	barcode_tracker_reset(filter->pTracker);
 
 	GST_OBJECT_UNLOCK(filter);
 
+	// streamWork belongs to this thread, jobWork waits for a running decode,
+	// which must not keep property access waiting as well
+	if (bLumaCopy)
+	{
+		luma_plane_reserve(&filter->streamWork.luma, width, height);
+		g_mutex_lock(&filter->decodeLock);
+		luma_plane_reserve(&filter->jobWork.luma, width, height);
+		g_mutex_unlock(&filter->decodeLock);
+	}
+	else
+	{
+		luma_plane_clear(&filter->streamWork.luma);
+		g_mutex_lock(&filter->decodeLock);
+		luma_plane_clear(&filter->jobWork.luma);
+		g_mutex_unlock(&filter->decodeLock);
+	}
+
+	gst_barcode_reader_update_passthrough(filter);
+
 	return filter->eImageFormat != ZXing_ImageFormat_None;
 }
 
-#define ZXING_BARCODE_TO_GST_STRUCT(zxing_barcode)															\
-	gst_structure_new(																						\
-		"barcode",																							\
-		"text", G_TYPE_STRING, ZXing_Barcode_text(zxing_barcode),											\
-		"format", G_TYPE_STRING, ZXing_BarcodeFormatToString(ZXing_Barcode_format(zxing_barcode)), NULL)
-
-static void gst_get_new_barcodes(GstBarcodeReader* filter, ZXing_Barcodes* pBarcodes, GArray* pNewBarcodes)
+// points image at the frame's pixels, only v210 needs its luma unpacked into pLuma
+static void gst_barcode_reader_map_image(GstVideoFrame* frame, ZXing_ImageFormat eFormat, GstBarcodeReaderImage* image, LumaPlane* pLuma)
 {
-	if (!filter->pBarcodes)
-	{
-		for (int i = 0, n = ZXing_Barcodes_size(pBarcodes); i < n; ++i)
-		{
-			const ZXing_Barcode* pBarcode = ZXing_Barcodes_at(pBarcodes, i);
-			GstStructure* pBarcodeInfo = ZXING_BARCODE_TO_GST_STRUCT(pBarcode);
+	const GstVideoFormatInfo* finfo = frame->info.finfo;
 
-			g_array_append_val(pNewBarcodes, pBarcodeInfo);
-		}
+	image->width = GST_VIDEO_FRAME_WIDTH(frame);
+	image->height = GST_VIDEO_FRAME_HEIGHT(frame);
+	image->eFormat = eFormat;
 
-		return;
-	}
+	if (GST_VIDEO_FRAME_FORMAT(frame) == GST_VIDEO_FORMAT_v210)
+	{
+		luma_plane_reserve(pLuma, image->width, image->height);
+		luma_extract_v210(GST_VIDEO_FRAME_PLANE_DATA(frame, 0), image->width, image->height,
+			GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0), pLuma->pData, pLuma->stride);
 
-	for (int i = 0, n = ZXing_Barcodes_size(pBarcodes); i < n; ++i)
+		image->pData = pLuma->pData;
+		image->rowStride = pLuma->stride;
+		image->pixStride = 1;
+	}
+	else if (eFormat == ZXing_ImageFormat_Lum)
 	{
-		gboolean bBarcodeFound = FALSE;
-		const ZXing_Barcode* pBarcode = ZXing_Barcodes_at(pBarcodes, i);
-		char* pNewBarcodeTxt = ZXing_Barcode_text(pBarcode);
-		char* pNewBarcodeFmt = ZXing_BarcodeFormatToString(ZXing_Barcode_format(pBarcode));
+		// the luma component of planar and packed YUV, for samples wider than
+		// 8 bits the most significant byte
+		image->pData = GST_VIDEO_FRAME_COMP_DATA(frame, GST_VIDEO_COMP_Y);
+		image->rowStride = GST_VIDEO_FRAME_COMP_STRIDE(frame, GST_VIDEO_COMP_Y);
+		image->pixStride = GST_VIDEO_FRAME_COMP_PSTRIDE(frame, GST_VIDEO_COMP_Y);
+
+		if (GST_VIDEO_FORMAT_INFO_DEPTH(finfo, GST_VIDEO_COMP_Y) > 8 && GST_VIDEO_FORMAT_INFO_IS_LE(finfo))
+			image->pData++;
+	}
+	else
+	{
+		// packed RGB, eFormat carries the channel offsets
+		image->pData = GST_VIDEO_FRAME_PLANE_DATA(frame, 0);
+		image->rowStride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0);
+		image->pixStride = GST_VIDEO_FRAME_COMP_PSTRIDE(frame, 0);
+	}
+}
 
-		for (guint j = 0; j < filter->pBarcodes->len; j++)
-		{
-			GstStructure* pBarcode = g_array_index(filter->pBarcodes, GstStructure*, j);
+// must be called with the object lock held, maps the streaming thread's frame
+// on first use only so frames that are never looked at aren't unpacked
+static const GstBarcodeReaderImage* gst_barcode_reader_frame_image(GstBarcodeReader* filter, GstVideoFrame* frame, GstBarcodeReaderImage* image)
+{
+	if (!image->pData)
+		gst_barcode_reader_map_image(frame, filter->eImageFormat, image, &filter->streamWork.luma);
 
-			const gchar* pBarcodeTxt = gst_structure_get_string(pBarcode, "text");
-			const gchar* pBarcodeFmt = gst_structure_get_string(pBarcode, "format");
+	return image;
+}
 
-			if (g_strcmp0(pNewBarcodeTxt, pBarcodeTxt) == 0 && g_strcmp0(pNewBarcodeFmt, pBarcodeFmt) == 0)
-			{
-				bBarcodeFound = TRUE;
-				break;
-			}
-		}
+// copies the luma inside the regions into pLuma and points pLumaImage at it,
+// pixels outside of the regions are left undefined
+static void gst_barcode_reader_copy_luma(const GstBarcodeReaderImage* image, GArray* pRegions,
+	LumaPlane* pLuma, GstBarcodeReaderImage* pLumaImage)
+{
+	luma_plane_reserve(pLuma, image->width, image->height);
+
+	for (guint i = 0; i < pRegions->len; i++)
+	{
+		const GstBarcodeReaderRegion* region = &g_array_index(pRegions, GstBarcodeReaderRegion, i);
+		const guint8* pSrc = image->pData + (gsize)region->y * image->rowStride + (gsize)region->x * image->pixStride;
+		guint8* pDst = pLuma->pData + (gsize)region->y * pLuma->stride + region->x;
 
-		if (!bBarcodeFound)
+		if (image->eFormat == ZXing_ImageFormat_Lum)
+		{
+			luma_copy(pSrc, region->width, region->height, image->rowStride, image->pixStride, pDst, pLuma->stride);
+		}
+		else
 		{
-			GstStructure* pBarcodeInfo = ZXING_BARCODE_TO_GST_STRUCT(pBarcode);
-			g_array_append_val(pNewBarcodes, pBarcodeInfo);
+			luma_from_rgb(pSrc, region->width, region->height, image->rowStride, image->pixStride,
+				(image->eFormat >> 16) & 0xFF, (image->eFormat >> 8) & 0xFF, image->eFormat & 0xFF, pDst, pLuma->stride);
 		}
 	}
+
+	pLumaImage->pData = pLuma->pData;
+	pLumaImage->width = image->width;
+	pLumaImage->height = image->height;
+	pLumaImage->rowStride = pLuma->stride;
+	pLumaImage->pixStride = 1;
+	pLumaImage->eFormat = ZXing_ImageFormat_Lum;
 }
 
-static GstFlowReturn gst_barcode_reader_transform_frame_ip (GstVideoFilter * vfilter, GstVideoFrame * frame)
+// ZXing would convert RGB to luma on every read, do it once per frame and only
+// inside the regions. Returns image itself when it already is luma
+static const GstBarcodeReaderImage* gst_barcode_reader_luma_image(const GstBarcodeReaderImage* image, GArray* pRegions,
+	LumaPlane* pLuma, GstBarcodeReaderImage* pLumaImage)
 {
-	GstBarcodeReader *filter = GST_BARCODE_READER (vfilter);
-	guint8* pImage = GST_VIDEO_FRAME_PLANE_DATA(frame, 0);
-
-	if (filter->eImageFormat == ZXing_ImageFormat_None)
-		goto not_negotiated;
+	if (image->eFormat == ZXing_ImageFormat_Lum)
+		return image;
 
-	time_t currentTime;
-	time(&currentTime);
+	gst_barcode_reader_copy_luma(image, pRegions, pLuma, pLumaImage);
 
-	GST_OBJECT_LOCK(filter);
+	return pLumaImage;
+}
 
-	if (filter->bEnableReader && filter->uBarcodeFormats != 0)
-	{
-		ZXing_ImageView* iv = ZXing_ImageView_new(pImage, filter->width, filter->height, filter->eImageFormat, 0, 0);
+static gboolean gst_barcode_reader_has_invalid(const ZXing_Barcodes* barcodes)
+{
+	for (int i = 0, n = ZXing_Barcodes_size(barcodes); i < n; ++i)
+		if (!ZXing_Barcode_isValid(ZXing_Barcodes_at(barcodes, i)))
+			return TRUE;
 
-		ZXing_ImageView_crop(iv, filter->uCoiStartX, 0, filter->uCoiWidth > 0 ? filter->uCoiWidth : filter->width - filter->uCoiStartX, 0);
+	return FALSE;
+}
 
-		ZXing_Barcodes* barcodes = ZXing_ReadBarcodes(iv, filter->pOpts);
-		
-		if (filter->uCoiStartX > 0 || (filter->uCoiWidth > 0 && filter->uCoiWidth != filter->width))
-			draw_column(pImage, filter->width, filter->height, filter->uCoiStartX, filter->uCoiStartX + filter->uCoiWidth - 1);
+static ZXing_Barcodes* gst_barcode_reader_decode_region(GstBarcodeReaderDecodeTask* task, const GstBarcodeReaderRegion* region)
+{
+	const GstBarcodeReaderConfig* pConfig = task->pConfig;
+	const GstBarcodeReaderImage* image = task->pImage;
+	const GstBarcodeReaderDecodeParams* pParams = task->pParams;
 
-		if (ZXing_Barcodes_size(barcodes))
-		{
-			GArray* pGstBarcodeList = g_array_new(FALSE, FALSE, sizeof(GstStructure*));
+	// decode straight out of padded buffers. The C API has no way to point a view at new data or
+	// to undo a crop, so a view can't be kept in the workspace and is made per region, next to
+	// the result list ZXing_ReadBarcodes allocates anyway
+	ZXing_ImageView* iv = ZXing_ImageView_new(image->pData, image->width, image->height, image->eFormat,
+		image->rowStride, image->pixStride);
+	ZXing_Barcodes* barcodes;
 
-			for (int i = 0, n = ZXing_Barcodes_size(barcodes); i < n; ++i)
-			{
-				const ZXing_Barcode* pBarcode = ZXing_Barcodes_at(barcodes, i);
+	ZXing_ImageView_crop(iv, region->x, region->y, region->width, region->height);
 
-				if (filter->bShowLocation)
-				{
-					ZXing_Position position = ZXing_Barcode_position(pBarcode);
-					position.bottomLeft.x += filter->uCoiStartX;
-					position.bottomRight.x += filter->uCoiStartX;
-					position.topLeft.x += filter->uCoiStartX;
-					position.topRight.x += filter->uCoiStartX;
+	if (!pParams->bAdaptiveEffort)
+	{
+		barcodes = ZXing_ReadBarcodes(iv, pConfig->pOpts);
+	}
+	else
+	{
+		barcodes = ZXing_ReadBarcodes(iv, pConfig->pCheapOpts);
 
-					draw_quad(pImage, filter->width, filter->height, position);
-				}
-			}
+		// something looks like a barcode but didn't decode, spend the rest of the budget on it
+		if (barcodes && gst_barcode_reader_has_invalid(barcodes)
+			&& (pParams->effortBudget == 0 || (GstClockTime)(g_get_monotonic_time() - task->startTime) * GST_USECOND < pParams->effortBudget))
+		{
+			ZXing_Barcodes* pThorough = ZXing_ReadBarcodes(iv, pConfig->pOpts);
 
-			if ((currentTime - filter->prevBarcodeTime) >= 2)
+			if (pThorough)
 			{
-				for (int i = 0, n = ZXing_Barcodes_size(barcodes); i < n; ++i)
-				{
-					const ZXing_Barcode* pBarcode = ZXing_Barcodes_at(barcodes, i);
-					char* pBarcodeTxt = ZXing_Barcode_text(pBarcode);
-					char* pBarcodeFmt = ZXing_BarcodeFormatToString(ZXing_Barcode_format(pBarcode));
-					GstStructure* pBarcodeInfo = ZXING_BARCODE_TO_GST_STRUCT(pBarcode);
-
-					g_array_append_val(pGstBarcodeList, pBarcodeInfo);
-				}
+				ZXing_Barcodes_delete(barcodes);
+				barcodes = pThorough;
+			}
+		}
+	}
 
-				g_signal_emit(GST_BARCODE_READER(vfilter), gst_barcode_reader_signals[BARCODE_SIGNAL], 0, pGstBarcodeList);
+	ZXing_ImageView_delete(iv);
 
-				if (filter->pBarcodes)
-				{
-					for (guint i = 0; i < filter->pBarcodes->len; i++)
-					{
-						GstStructure* structure = g_array_index(filter->pBarcodes, GstStructure*, i);
-						gst_structure_free(structure);
-					}
+	return barcodes;
+}
 
-					g_array_unref(filter->pBarcodes);
-				}
+static void gst_barcode_reader_decode_task(guint index, gpointer user_data)
+{
+	GstBarcodeReaderDecodeTask* task = (GstBarcodeReaderDecodeTask*)user_data;
 
-				filter->pBarcodes = pGstBarcodeList;
-				filter->prevBarcodeTime = currentTime;
-			}
-			else
-			{
-				gst_get_new_barcodes(filter, barcodes, pGstBarcodeList);
+	task->ppBarcodes[index] = gst_barcode_reader_decode_region(task, &task->pRegions[index]);
+}
 
-				if (pGstBarcodeList->len)
-					g_signal_emit(GST_BARCODE_READER(vfilter), gst_barcode_reader_signals[BARCODE_SIGNAL], 0, pGstBarcodeList);
+static void gst_barcode_reader_workspace_init(GstBarcodeReaderWorkspace* pWork)
+{
+	memset(pWork, 0, sizeof(*pWork));
+	pWork->pResults = g_ptr_array_new_with_free_func((GDestroyNotify)gst_mini_object_unref);
+	pWork->pCandidates = g_array_new(FALSE, FALSE, sizeof(GstBarcodeReaderRegion));
+	pWork->pBarcodes = g_ptr_array_new();
+	pWork->pReport = g_array_new(FALSE, FALSE, sizeof(GstStructure*));
+}
 
-				if (filter->pBarcodes)
-				{
-					for (guint i = 0; i < pGstBarcodeList->len; i++)
-					{
-						GstStructure* pBarcodeInfo = g_array_index(pGstBarcodeList, GstStructure*, i);
-						g_array_append_val(filter->pBarcodes, pBarcodeInfo);
-					}
-				}
-				else
-				{
-					filter->pBarcodes = pGstBarcodeList;
-				}
-			}
-		}
-		
-		ZXing_Barcodes_delete(barcodes);
-		ZXing_ImageView_delete(iv);
-	}
+static void gst_barcode_reader_workspace_clear(GstBarcodeReaderWorkspace* pWork)
+{
+	luma_plane_clear(&pWork->luma);
+	g_ptr_array_unref(pWork->pResults);
+	g_array_unref(pWork->pCandidates);
+	g_ptr_array_unref(pWork->pBarcodes);
+	g_free(pWork->pScratch);
 
-	GST_OBJECT_UNLOCK(filter);
+	if (pWork->pBatch)
+		decode_batch_free(pWork->pBatch);
 
-	return GST_FLOW_OK;
+	for (guint i = 0; i < pWork->pReport->len; i++)
+		gst_structure_free(g_array_index(pWork->pReport, GstStructure*, i));
 
-not_negotiated:
-	GST_ERROR_OBJECT (filter, "Not negotiated yet");
-	return GST_FLOW_NOT_NEGOTIATED;
+	g_array_unref(pWork->pReport);
 }
 
-static void gst_barcode_reader_set_property(GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec)
+static void gst_barcode_reader_offset_position(ZXing_Position* position, gint x, gint y)
 {
-	GstBarcodeReader *filter = GST_BARCODE_READER (object);
+	position->topLeft.x += x;
+	position->topRight.x += x;
+	position->bottomRight.x += x;
+	position->bottomLeft.x += x;
+	position->topLeft.y += y;
+	position->topRight.y += y;
+	position->bottomRight.y += y;
+	position->bottomLeft.y += y;
+}
 
-	GST_OBJECT_LOCK(filter);
+static void gst_barcode_reader_add_candidate(GArray* pCandidates, const GstBarcodeReaderRegion* region, GstBarcodeReaderRegion candidate)
+{
+	gint right = MIN(candidate.x + candidate.width, region->x + region->width);
+	gint bottom = MIN(candidate.y + candidate.height, region->y + region->height);
 
-	switch (prop_id)
-	{
-	case PROP_BARCODE_FORMATS:
-		filter->uBarcodeFormats = g_value_get_flags(value);
-		filter->pOpts = gst_barcode_reader_new_zxing_opts(filter);
-		break;
+	candidate.x = MAX(candidate.x, region->x);
+	candidate.y = MAX(candidate.y, region->y);
+	candidate.width = right - candidate.x;
+	candidate.height = bottom - candidate.y;
 
-	case PROP_ENABLE_READER:
-		filter->bEnableReader = g_value_get_boolean(value);
-		break;
+	if (candidate.width <= 0 || candidate.height <= 0)
+		return;
 
-	case PROP_SHOW_LOCATION:
-		filter->bShowLocation = g_value_get_boolean(value);
-		break;
+	// merge overlapping windows so that no code gets decoded twice
+	for (guint i = 0; i < pCandidates->len; i++)
+	{
+		GstBarcodeReaderRegion* other = &g_array_index(pCandidates, GstBarcodeReaderRegion, i);
 
-	case PROP_COI_START_X:
-		filter->uCoiStartX = g_value_get_uint(value);
-		break;
+		if (candidate.x >= other->x + other->width || other->x >= candidate.x + candidate.width
+			|| candidate.y >= other->y + other->height || other->y >= candidate.y + candidate.height)
+			continue;
 
-	case PROP_COI_WIDTH:
-		filter->uCoiWidth = g_value_get_uint(value);
-		break;
+		right = MAX(candidate.x + candidate.width, other->x + other->width);
+		bottom = MAX(candidate.y + candidate.height, other->y + other->height);
+		candidate.x = MIN(candidate.x, other->x);
+		candidate.y = MIN(candidate.y, other->y);
+		candidate.width = right - candidate.x;
+		candidate.height = bottom - candidate.y;
 
-	default:
-		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-		break;
+		g_array_remove_index_fast(pCandidates, i);
+		gst_barcode_reader_add_candidate(pCandidates, region, candidate);
+		return;
 	}
 
-	GST_OBJECT_UNLOCK(filter);
+	g_array_append_val(pCandidates, candidate);
 }
 
-static void gst_barcode_reader_get_property(GObject * object, guint prop_id, GValue * value, GParamSpec * pspec)
+// runs the detection on a downscaled copy of each region and returns full
+// resolution windows around everything that looks like a barcode in pWork->pCandidates
+static GArray* gst_barcode_reader_detect_candidates(const GstBarcodeReaderConfig* pConfig, const GstBarcodeReaderImage* image,
+	GstBarcodeReaderWorkspace* pWork, GArray* pRegions, guint uFactor, guint uMaxCandidates)
 {
-	GstBarcodeReader* filter = GST_BARCODE_READER(object);
+	GArray* pCandidates = pWork->pCandidates;
+	gint rowStride = image->rowStride;
+	gint pixStride = image->pixStride;
 
-	GST_OBJECT_LOCK(filter);
+	g_array_set_size(pCandidates, 0);
 
-	switch (prop_id) 
+	// round down to a power of two, that's what the box filter does
+	while (uFactor & (uFactor - 1))
+		uFactor &= uFactor - 1;
+
+	for (guint i = 0; i < pRegions->len && pCandidates->len < uMaxCandidates; i++)
 	{
-	case PROP_BARCODE_FORMATS:
-		g_value_set_flags(value, filter->uBarcodeFormats);
-		break;
-	
-	case PROP_ENABLE_READER:
-		g_value_set_boolean(value, filter->bEnableReader);
-		break;
+		const GstBarcodeReaderRegion* region = &g_array_index(pRegions, GstBarcodeReaderRegion, i);
+		gint width = region->width / uFactor;
+		gint height = region->height / uFactor;
 
-	case PROP_SHOW_LOCATION:
-		g_value_set_boolean(value, filter->bShowLocation);
-		break;
+		if (width < 1 || height < 1)
+			continue;
 
-	case PROP_COI_START_X:
-		g_value_set_uint(value, filter->uCoiStartX);
-		break;
+		// the downscaled region, followed by the half size octave for factors >= 4
+		gsize dstSize = (gsize)width * height;
+		gsize tmpSize = uFactor >= 4 ? (gsize)(region->width / 2) * (region->height / 2) : 0;
 
-	case PROP_COI_WIDTH:
-		g_value_set_uint(value, filter->uCoiWidth);
-		break;
+		if (dstSize + tmpSize > pWork->scratchSize)
+		{
+			pWork->scratchSize = dstSize + tmpSize;
+			pWork->pScratch = g_realloc(pWork->pScratch, pWork->scratchSize);
+		}
 
-	default:
-		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
-		break;
+		luma_downscale(
+			image->pData + (gsize)region->y * rowStride + (gsize)region->x * pixStride, region->width, region->height, rowStride, pixStride,
+			(image->eFormat >> 8) & 0xFF, uFactor, pWork->pScratch, width, tmpSize ? pWork->pScratch + dstSize : NULL);
+
+		ZXing_ImageView* iv = ZXing_ImageView_new(pWork->pScratch, width, height, ZXing_ImageFormat_Lum, width, 1);
+		ZXing_Barcodes* barcodes = ZXing_ReadBarcodes(iv, pConfig->pDetectOpts);
+
+		ZXing_ImageView_delete(iv);
+
+		if (!barcodes)
+			continue;
+
+		for (int j = 0, n = ZXing_Barcodes_size(barcodes); j < n && pCandidates->len < uMaxCandidates; ++j)
+		{
+			ZXing_Position position = ZXing_Barcode_position(ZXing_Barcodes_at(barcodes, j));
+			gint minX = MIN(MIN(position.topLeft.x, position.topRight.x), MIN(position.bottomRight.x, position.bottomLeft.x));
+			gint maxX = MAX(MAX(position.topLeft.x, position.topRight.x), MAX(position.bottomRight.x, position.bottomLeft.x));
+			gint minY = MIN(MIN(position.topLeft.y, position.topRight.y), MIN(position.bottomRight.y, position.bottomLeft.y));
+			gint maxY = MAX(MAX(position.topLeft.y, position.topRight.y), MAX(position.bottomRight.y, position.bottomLeft.y));
+			GstBarcodeReaderRegion candidate;
+
+			// a detection can be off by a few downscaled pixels, leave room for the quiet zone
+			gint margin = MAX((gint)(MAX(maxX - minX, maxY - minY) * uFactor) / 2, CANDIDATE_MIN_MARGIN) + (gint)uFactor;
+
+			candidate.x = region->x + minX * (gint)uFactor - margin;
+			candidate.y = region->y + minY * (gint)uFactor - margin;
+			candidate.width = (maxX - minX + 1) * (gint)uFactor + 2 * margin;
+			candidate.height = (maxY - minY + 1) * (gint)uFactor + 2 * margin;
+
+			gst_barcode_reader_add_candidate(pCandidates, region, candidate);
+		}
+
+		ZXing_Barcodes_delete(barcodes);
 	}
 
-	GST_OBJECT_UNLOCK(filter);
+	return pCandidates;
 }
 
-static GType gst_barcode_reader_get_barcode_type(void)
+// needs no lock as long as nothing else uses pWork, returns pWork->pResults
+// which holds GstBarcodeResult until the next decode or until cleared
+static GPtrArray* gst_barcode_reader_decode(const GstBarcodeReaderConfig* pConfig, const GstBarcodeReaderImage* image,
+	GstBarcodeReaderWorkspace* pWork, const GstBarcodeReaderDecodeParams* pParams, GArray* pRegions)
 {
-	static GType barcode_type = 0;
-	if (!barcode_type)
+	GstBarcodeReaderDecodeTask task;
+	GstBarcodeReaderImage lumaImage;
+	GPtrArray* pResults = pWork->pResults;
+
+	task.startTime = g_get_monotonic_time();
+
+	g_ptr_array_set_size(pResults, 0);
+
+	if (pParams->uPyramidFactor > 1)
 	{
-		static const GFlagsValue barcode_types[] = {
-			{ ZXing_BarcodeFormat_None, "None", "none" },
-			{ ZXing_BarcodeFormat_Aztec, "Aztec", "aztec" },
-			{ ZXing_BarcodeFormat_Codabar, "Codabar", "codabar" },
-			{ ZXing_BarcodeFormat_Code39, "Code 39", "code-39" },
-			{ ZXing_BarcodeFormat_Code93, "Code 93", "code-93" },
-			{ ZXing_BarcodeFormat_Code128, "Code 128", "code-128" },
-			{ ZXing_BarcodeFormat_DataBar, "Data Bar", "data-bar" },
-			{ ZXing_BarcodeFormat_DataBarExpanded, "Data Bar Expanded", "data-bar-expanded" },
-			{ ZXing_BarcodeFormat_DataMatrix, "Data Matrix", "data-matrix" },
-			{ ZXing_BarcodeFormat_EAN8, "EAN 8", "ean-8" },
-			{ ZXing_BarcodeFormat_EAN13, "EAN 13", "ean-13" },
-			{ ZXing_BarcodeFormat_ITF, "ITF", "itf" },
-			{ ZXing_BarcodeFormat_MaxiCode, "Maxi Code", "maxi-code" },
-			{ ZXing_BarcodeFormat_PDF417, "PDF417", "pdf417" },
-			{ ZXing_BarcodeFormat_QRCode, "QR Code", "qr-code" },
-			{ ZXing_BarcodeFormat_UPCA, "UPCA", "upca" },
-			{ ZXing_BarcodeFormat_UPCE, "UPCE", "upce" },
-			{ ZXing_BarcodeFormat_MicroQRCode, "Micro QR Code", "micro-qr-code" },
-			{ ZXing_BarcodeFormat_RMQRCode, "RM QR Code", "rm-qr-code" },
-			{ ZXing_BarcodeFormat_DXFilmEdge, "DX Film Edge", "dx-film-edge" },
-			{ ZXing_BarcodeFormat_DataBarLimited, "Data Bar Limited", "data-bar-limited" },
-			{ ZXing_BarcodeFormat_LinearCodes, "All Linear Codes", "linear-codes" },
-			{ ZXing_BarcodeFormat_MatrixCodes, "All Matrix Codes", "matrix-codes" },
-			{ ZXing_BarcodeFormat_Any, "Any Code", "any" },
-			{ 0, NULL, NULL }
-		};
-		barcode_type = g_flags_register_static("BarcodeType", barcode_types);
+		GArray* pCandidates = gst_barcode_reader_detect_candidates(pConfig, image, pWork, pRegions,
+			pParams->uPyramidFactor, pParams->uMaxCandidates);
+
+		// the downscaled copy misses exactly the codes that are small at full resolution
+		if (pCandidates->len > 0 || !pParams->bPyramidFullScan)
+			pRegions = pCandidates;
 	}
-	return barcode_type;
-}
 
-GType garray_get_type(void)
-{
-	static GType type = 0;
+	g_ptr_array_set_size(pWork->pBarcodes, pRegions->len);
 
-	if (type == 0)
+	task.pConfig = pConfig;
+	task.pImage = gst_barcode_reader_luma_image(image, pRegions, &pWork->luma, &lumaImage);
+	task.pParams = pParams;
+	task.pRegions = (const GstBarcodeReaderRegion*)pRegions->data;
+	task.ppBarcodes = pWork->pBarcodes->pdata;
+
+	// regions are independent, ZXing only reads the shared options
+	if (pParams->pPool)
 	{
-		type = g_boxed_type_register_static(
-			"GBarcodeArray",
-			(GBoxedCopyFunc)g_array_ref,
-			(GBoxedFreeFunc)g_array_unref
-		);
+		if (!pWork->pBatch)
+			pWork->pBatch = decode_batch_new(pParams->pPool);
+
+		decode_batch_run(pWork->pBatch, pRegions->len, gst_barcode_reader_decode_task, &task);
 	}
+	else
+		for (guint i = 0; i < pRegions->len; i++)
+			gst_barcode_reader_decode_task(i, &task);
 
-	return type;
-}
+	for (guint i = 0; i < pRegions->len; i++)
+	{
+		const GstBarcodeReaderRegion* region = &task.pRegions[i];
+		ZXing_Barcodes* barcodes = (ZXing_Barcodes*)task.ppBarcodes[i];
 
-static void gst_barcode_reader_class_init (GstBarcodeReaderClass * klass)
+		if (!barcodes)
+			continue;
+
+		for (int j = 0, n = ZXing_Barcodes_size(barcodes); j < n; ++j)
+		{
+			ZXing_Position position;
+
+			// errors are only asked for to decide on escalation
+			if (!ZXing_Barcode_isValid(ZXing_Barcodes_at(barcodes, j)))
+				continue;
+
+			position = ZXing_Barcode_position(ZXing_Barcodes_at(barcodes, j));
+			gst_barcode_reader_offset_position(&position, region->x, region->y);
+			g_ptr_array_add(pResults, gst_barcode_result_new(ZXing_Barcodes_move(barcodes, j), &position));
+		}
+
+		ZXing_Barcodes_delete(barcodes);
+	}
+
+	return pResults;
+}
+
+static void gst_barcode_reader_add_region(GArray* pRegions, gint x, gint y, gint width, gint height, gint frameWidth, gint frameHeight)
+{
+	GstBarcodeReaderRegion region;
+
+	// clip to the frame, ZXing_ImageView_crop treats 0 as the remaining size
+	region.x = CLAMP(x, 0, frameWidth);
+	region.y = CLAMP(y, 0, frameHeight);
+	region.width = MIN(x + width, frameWidth) - region.x;
+	region.height = MIN(y + height, frameHeight) - region.y;
+
+	if (region.width > 0 && region.height > 0)
+		g_array_append_val(pRegions, region);
+}
+
+// must be called with the object lock held, fills pFrameRegions with the
+// configured ROIs, upstream ROI metas or else the column of interest
+static void gst_barcode_reader_collect_regions(GstBarcodeReader* filter, GstBuffer* buffer)
+{
+	g_array_set_size(filter->pFrameRegions, 0);
+
+	for (guint i = 0; i < filter->pRegions->len; i++)
+	{
+		GstBarcodeReaderRegion* region = &g_array_index(filter->pRegions, GstBarcodeReaderRegion, i);
+		gst_barcode_reader_add_region(filter->pFrameRegions, region->x, region->y, region->width, region->height, filter->width, filter->height);
+	}
+
+	if (filter->bUseRoiMeta)
+	{
+		GQuark barcodeQuark = g_quark_from_static_string("barcode");
+		gpointer state = NULL;
+		GstMeta* meta;
+
+		while ((meta = gst_buffer_iterate_meta_filtered(buffer, &state, GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE)))
+		{
+			GstVideoRegionOfInterestMeta* roi = (GstVideoRegionOfInterestMeta*)meta;
+
+			// skip our own results of a previous reader
+			if (roi->roi_type == barcodeQuark)
+				continue;
+
+			gst_barcode_reader_add_region(filter->pFrameRegions, roi->x, roi->y, roi->w, roi->h, filter->width, filter->height);
+		}
+	}
+
+	if (filter->pFrameRegions->len == 0)
+	{
+		guint uCoiWidth = filter->uCoiWidth > 0 ? filter->uCoiWidth : filter->width - MIN(filter->uCoiStartX, (guint)filter->width);
+		gst_barcode_reader_add_region(filter->pFrameRegions, filter->uCoiStartX, 0, uCoiWidth, filter->height, filter->width, filter->height);
+	}
+}
+
+// must be called with the object lock held, returns FALSE when nothing moved
+// since the last decoded frame and narrows the regions down to the changes
+static gboolean gst_barcode_reader_motion_gate(GstBarcodeReader* filter, GstVideoFrame* frame, GstBarcodeReaderImage* image)
+{
+	guint uRegions = 0;
+
+	if (filter->uMotionThreshold == 0)
+		return TRUE;
+
+	gst_barcode_reader_frame_image(filter, frame, image);
+
+	// green stands in for luma in the RGB formats
+	motion_gate_update(
+		filter->pMotionGate,
+		image->pData,
+		image->width,
+		image->height,
+		image->rowStride,
+		image->pixStride,
+		(image->eFormat >> 8) & 0xFF);
+
+	if (motion_gate_compare(filter->pMotionGate, filter->uMotionThreshold) == 0)
+		return FALSE;
+
+	if (filter->bMotionRestrict)
+	{
+		for (guint i = 0; i < filter->pFrameRegions->len; i++)
+		{
+			GstBarcodeReaderRegion region = g_array_index(filter->pFrameRegions, GstBarcodeReaderRegion, i);
+
+			if (motion_gate_clip_to_changes(filter->pMotionGate, &region.x, &region.y, &region.width, &region.height))
+				g_array_index(filter->pFrameRegions, GstBarcodeReaderRegion, uRegions++) = region;
+		}
+
+		g_array_set_size(filter->pFrameRegions, uRegions);
+
+		if (uRegions == 0)
+			return FALSE;
+	}
+
+	motion_gate_commit(filter->pMotionGate);
+
+	return TRUE;
+}
+
+static void gst_barcode_reader_add_tracked_region(gint x, gint y, gint width, gint height, gpointer user_data)
+{
+	GstBarcodeReader* filter = GST_BARCODE_READER(user_data);
+
+	gst_barcode_reader_add_region(filter->pFrameRegions, x, y, width, height, filter->width, filter->height);
+}
+
+// must be called with the object lock held, replaces the regions with windows
+// around the predicted positions of the tracked barcodes unless a full scan is
+// due, returns FALSE when all of them are predicted outside of the frame
+static gboolean gst_barcode_reader_track_regions(GstBarcodeReader* filter, GstClockTime runningTime)
+{
+	if (!filter->bTracking)
+		return TRUE;
+
+	if (filter->bFullScanPending || barcode_tracker_size(filter->pTracker) == 0
+		|| ++filter->uFramesSinceFullScan >= filter->uFullScanInterval)
+	{
+		filter->bFullScanPending = FALSE;
+		filter->uFramesSinceFullScan = 0;
+		return TRUE;
+	}
+
+	g_array_set_size(filter->pFrameRegions, 0);
+	barcode_tracker_predict(filter->pTracker, runningTime, gst_barcode_reader_add_tracked_region, filter);
+
+	return filter->pFrameRegions->len > 0;
+}
+
+static void gst_barcode_reader_draw_region(Overlay* overlay, const GstBarcodeReaderRegion* region)
+{
+	ZXing_Position position;
+
+	position.topLeft.x = region->x;
+	position.topLeft.y = region->y;
+	position.topRight.x = region->x + region->width - 1;
+	position.topRight.y = region->y;
+	position.bottomRight.x = region->x + region->width - 1;
+	position.bottomRight.y = region->y + region->height - 1;
+	position.bottomLeft.x = region->x;
+	position.bottomLeft.y = region->y + region->height - 1;
+
+	draw_quad(overlay, position);
+}
+
+static void gst_barcode_reader_fill_barcode(Overlay* overlay, const ZXing_Position* position, guint8 alpha)
+{
+	gint minX = MIN(MIN(position->topLeft.x, position->topRight.x), MIN(position->bottomRight.x, position->bottomLeft.x));
+	gint maxX = MAX(MAX(position->topLeft.x, position->topRight.x), MAX(position->bottomRight.x, position->bottomLeft.x));
+	gint minY = MIN(MIN(position->topLeft.y, position->topRight.y), MIN(position->bottomRight.y, position->bottomLeft.y));
+	gint maxY = MAX(MAX(position->topLeft.y, position->topRight.y), MAX(position->bottomRight.y, position->bottomLeft.y));
+
+	draw_box(overlay, minX, minY, maxX - minX + 1, maxY - minY + 1, alpha);
+}
+
+// throttling and dedup run on the buffer running time so that replaying a
+// recording at any speed yields the same results as live capture
+static GstClockTime gst_barcode_reader_running_time(GstBarcodeReader* filter, GstBuffer* buffer)
+{
+	GstBaseTransform* trans = GST_BASE_TRANSFORM(filter);
+	GstClockTime runningTime = GST_CLOCK_TIME_NONE;
+
+	if (GST_BUFFER_PTS_IS_VALID(buffer) && trans->segment.format == GST_FORMAT_TIME)
+		runningTime = gst_segment_to_running_time(&trans->segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+
+	if (!GST_CLOCK_TIME_IS_VALID(runningTime))
+		runningTime = g_get_monotonic_time() * GST_USECOND;
+
+	return runningTime;
+}
+
+static void gst_barcode_reader_reset_cadence(GstBarcodeReader* filter)
+{
+	filter->uAdaptiveInterval = 1;
+	filter->uEmptyDecodes = 0;
+	filter->uFramesSinceDecode = G_MAXUINT;
+	filter->lastDecodeTime = GST_CLOCK_TIME_NONE;
+}
+
+// must be called with the object lock held
+static gboolean gst_barcode_reader_should_decode(GstBarcodeReader* filter, GstClockTime timestamp)
+{
+	guint uInterval = filter->uDecodeInterval;
+
+	if (filter->bAdaptiveDecode)
+		uInterval = MAX(uInterval, filter->uAdaptiveInterval);
+
+	if (filter->uFramesSinceDecode < G_MAXUINT)
+		filter->uFramesSinceDecode++;
+
+	if (filter->uFramesSinceDecode < uInterval)
+		return FALSE;
+
+	if (filter->dMaxDecodeFps > 0 && GST_CLOCK_TIME_IS_VALID(timestamp) && GST_CLOCK_TIME_IS_VALID(filter->lastDecodeTime)
+		&& timestamp > filter->lastDecodeTime && (timestamp - filter->lastDecodeTime) < (GstClockTime)(GST_SECOND / filter->dMaxDecodeFps))
+		return FALSE;
+
+	filter->uFramesSinceDecode = 0;
+	filter->lastDecodeTime = timestamp;
+
+	return TRUE;
+}
+
+// must be called with the object lock held
+static void gst_barcode_reader_update_cadence(GstBarcodeReader* filter, gboolean bFound)
+{
+	if (bFound)
+	{
+		filter->uAdaptiveInterval = 1;
+		filter->uEmptyDecodes = 0;
+	}
+	else if (++filter->uEmptyDecodes >= filter->uAdaptiveIdleFrames)
+	{
+		// back off exponentially while the scene stays empty
+		filter->uAdaptiveInterval = MIN(filter->uAdaptiveInterval * 2, filter->uAdaptiveMaxInterval);
+		filter->uEmptyDecodes = 0;
+	}
+}
+
+// must be called with the object lock held, queues the barcodes for the next message
+static void gst_barcode_reader_report(GstBarcodeReader* filter, GArray* pGstBarcodeList, GstClockTime pts, GstClockTime runningTime)
+{
+	if (!filter->bPostMessages)
+		return;
+
+	if (filter->pMessageBarcodes->len == 0)
+	{
+		filter->messageBatchStart = runningTime;
+		filter->uMessageBatchedFrames = 0;
+	}
+
+	for (guint i = 0; i < pGstBarcodeList->len; i++)
+	{
+		GstStructure* pBarcodeInfo = gst_structure_copy(g_array_index(pGstBarcodeList, GstStructure*, i));
+
+		gst_structure_set(
+			pBarcodeInfo,
+			"pts", G_TYPE_UINT64, pts,
+			"running-time", G_TYPE_UINT64, runningTime, NULL);
+		g_ptr_array_add(filter->pMessageBarcodes, pBarcodeInfo);
+	}
+}
+
+// must be called with the object lock held, the message has to be posted
+// after unlocking since posting takes the object lock as well
+static GstMessage* gst_barcode_reader_take_message(GstBarcodeReader* filter, GstClockTime runningTime, gboolean bForce)
+{
+	if (filter->pMessageBarcodes->len == 0)
+		return NULL;
+
+	if (!bForce)
+	{
+		gboolean bDue = filter->uMessageBatchFrames == 0 && filter->messageBatchTime == 0;
+
+		if (filter->uMessageBatchFrames > 0 && filter->uMessageBatchedFrames >= filter->uMessageBatchFrames)
+			bDue = TRUE;
+
+		if (filter->messageBatchTime > 0 && GST_CLOCK_TIME_IS_VALID(runningTime) && GST_CLOCK_TIME_IS_VALID(filter->messageBatchStart)
+			&& runningTime >= filter->messageBatchStart + filter->messageBatchTime)
+			bDue = TRUE;
+
+		if (!bDue)
+			return NULL;
+	}
+
+	GValue list = G_VALUE_INIT;
+	g_value_init(&list, GST_TYPE_LIST);
+
+	// the list takes over the queued structures
+	gsize uCount;
+	GstStructure** ppBarcodes = (GstStructure**)g_ptr_array_steal(filter->pMessageBarcodes, &uCount);
+
+	for (gsize i = 0; i < uCount; i++)
+	{
+		GValue value = G_VALUE_INIT;
+
+		g_value_init(&value, GST_TYPE_STRUCTURE);
+		g_value_take_boxed(&value, ppBarcodes[i]);
+		gst_value_list_append_and_take_value(&list, &value);
+	}
+
+	g_free(ppBarcodes);
+
+	GstStructure* pStructure = gst_structure_new(
+		"barcode",
+		"frames", G_TYPE_UINT, filter->uMessageBatchedFrames,
+		"batch-start", G_TYPE_UINT64, filter->messageBatchStart, NULL);
+	gst_structure_take_value(pStructure, "barcodes", &list);
+
+	return gst_message_new_element(GST_OBJECT(filter), pStructure);
+}
+
+static void gst_barcode_reader_post_message(GstBarcodeReader* filter, GstMessage* pMessage)
+{
+	if (pMessage)
+		gst_element_post_message(GST_ELEMENT(filter), pMessage);
+}
+
+// must be called without the object lock, handlers may well get or set properties
+static void gst_barcode_reader_emit_report(GstBarcodeReader* filter, GstBarcodeReaderWorkspace* pWork)
+{
+	GArray* pGstBarcodeList = pWork->pReport;
+
+	if (pWork->bEmitReport && pGstBarcodeList->len)
+		g_signal_emit(filter, gst_barcode_reader_signals[BARCODE_SIGNAL], 0, pGstBarcodeList);
+
+	for (guint i = 0; i < pGstBarcodeList->len; i++)
+		gst_structure_free(g_array_index(pGstBarcodeList, GstStructure*, i));
+
+	g_array_set_size(pGstBarcodeList, 0);
+	pWork->bEmitReport = FALSE;
+}
+
+// must be called with the object lock held, leaves the structures for
+// barcode-signal in pWork->pReport for gst_barcode_reader_emit_report
+static void gst_barcode_reader_handle_barcodes(GstBarcodeReader* filter, GstBarcodeReaderWorkspace* pWork, GstClockTime pts, GstClockTime runningTime)
+{
+	GPtrArray* pResults = pWork->pResults;
+	gboolean bCollectMeta = filter->bAttachMeta || filter->bAttachRoiMeta;
+	gboolean bReport;
+
+	gst_barcode_reader_update_cadence(filter, pResults->len > 0);
+
+	g_array_set_size(filter->pPositions, 0);
+	g_array_set_size(filter->pMetaBarcodes, 0);
+
+	for (guint i = 0; i < pResults->len; i++)
+	{
+		GstBarcodeResult* result = g_ptr_array_index(pResults, i);
+		ZXing_Position position = result->position;
+
+		g_array_append_val(filter->pPositions, position);
+
+		if (bCollectMeta)
+		{
+			GstBarcodeMetaEntry entry;
+
+			entry.text = g_strdup(gst_barcode_result_get_text(result));
+			entry.format = gst_barcode_result_get_format_name(result);
+			entry.position = position;
+			g_array_append_val(filter->pMetaBarcodes, entry);
+		}
+	}
+
+	// in async mode the results go out on the next buffer, pts names the decoded frame
+	filter->metaPts = pts;
+	filter->bMetaPending = bCollectMeta && filter->pMetaBarcodes->len > 0;
+
+	if (filter->bTracking)
+	{
+		for (guint i = 0; i < pResults->len; i++)
+		{
+			GstBarcodeResult* result = g_ptr_array_index(pResults, i);
+
+			barcode_tracker_update(filter->pTracker, gst_barcode_result_get_format_name(result),
+				gst_barcode_result_get_text(result), &result->position, runningTime);
+		}
+
+		// a code that left its window may have jumped, look at the whole frame again
+		if (barcode_tracker_expire(filter->pTracker, runningTime, TRACKER_MAX_MISSES) > 0)
+			filter->bFullScanPending = TRUE;
+	}
+
+	if (!pResults->len)
+		return;
+
+	GArray* pGstBarcodeList = pWork->pReport;
+
+	// structures are only built for somebody who will see them
+	pWork->bEmitReport = filter->bEmitSignals
+		&& g_signal_has_handler_pending(filter, gst_barcode_reader_signals[BARCODE_SIGNAL], 0, FALSE);
+	bReport = filter->bPostMessages || pWork->bEmitReport;
+
+	for (guint i = 0; i < pResults->len; i++)
+	{
+		GstBarcodeResult* result = g_ptr_array_index(pResults, i);
+		const gchar* pText = gst_barcode_result_get_text(result);
+		const gchar* pFormat = gst_barcode_result_get_format_name(result);
+
+		// repeats of a code are filtered out before anything is built for them,
+		// the cache still sees them while nobody listens
+		if (barcode_cache_check(filter->pBarcodeCache, pFormat, pText, runningTime, filter->dedupTtl) && bReport)
+		{
+			GstStructure* pBarcodeInfo = gst_structure_new(
+				"barcode",
+				"text", G_TYPE_STRING, pText,
+				"format", G_TYPE_STRING, pFormat,
+				"result", GST_TYPE_BARCODE_RESULT, result, NULL);
+
+			g_array_append_val(pGstBarcodeList, pBarcodeInfo);
+		}
+	}
+
+	if (pGstBarcodeList->len)
+		gst_barcode_reader_report(filter, pGstBarcodeList, pts, runningTime);
+}
+
+// must be called with the object lock held
+static void gst_barcode_reader_get_decode_params(GstBarcodeReader* filter, GstBarcodeReaderDecodeParams* pParams)
+{
+	pParams->eImageFormat = filter->eImageFormat;
+	// referenced until stop, taking the pool per frame would start and join
+	// its threads every time nothing else keeps it alive
+	if (filter->bParallelRoi && !filter->pDecodePool)
+		filter->pDecodePool = decode_pool_ref();
+
+	pParams->pPool = filter->bParallelRoi ? filter->pDecodePool : NULL;
+	pParams->uPyramidFactor = filter->uPyramidFactor;
+	pParams->uMaxCandidates = filter->uMaxCandidates;
+	pParams->bPyramidFullScan = FALSE;
+	pParams->bAdaptiveEffort = filter->bAdaptiveEffort;
+	pParams->effortBudget = filter->effortBudget;
+}
+
+// must be called with the object lock held for every frame that is decoded,
+// marks every Nth of them for a full scan should the pyramid pass find nothing
+static void gst_barcode_reader_count_pyramid_scan(GstBarcodeReader* filter, GstBarcodeReaderDecodeParams* pParams)
+{
+	if (pParams->uPyramidFactor <= 1 || filter->uPyramidFullScanInterval == 0)
+		return;
+
+	if (++filter->uFramesSincePyramidScan >= filter->uPyramidFullScanInterval)
+	{
+		filter->uFramesSincePyramidScan = 0;
+		pParams->bPyramidFullScan = TRUE;
+	}
+}
+
+static void gst_barcode_reader_reset_qos(GstBarcodeReader* filter)
+{
+	filter->dQosProportion = 1.0;
+	filter->qosEarliestTime = GST_CLOCK_TIME_NONE;
+}
+
+// must be called with the object lock held
+static void gst_barcode_reader_update_decode_cost(GstBarcodeReader* filter, GstClockTime cost)
+{
+	if (filter->dDecodeCost < 0)
+		filter->dDecodeCost = (gdouble)cost;
+	else
+		filter->dDecodeCost += DECODE_COST_WEIGHT * ((gdouble)cost - filter->dDecodeCost);
+}
+
+// must be called with the object lock held, returns FALSE when the frame
+// should not be decoded at all and otherwise may downgrade pParams
+static gboolean gst_barcode_reader_check_deadline(GstBarcodeReader* filter, GstClockTime runningTime, GstBarcodeReaderDecodeParams* pParams)
+{
+	// the sink already reported this frame as late, decoding only adds to it
+	if (GST_CLOCK_TIME_IS_VALID(filter->qosEarliestTime) && runningTime < filter->qosEarliestTime)
+		return FALSE;
+
+	if (filter->maxDecodeLatency == 0 || filter->dDecodeCost < 0)
+		return TRUE;
+
+	if (filter->dDecodeCost > 2.0 * filter->maxDecodeLatency)
+	{
+		filter->dDecodeCost *= DECODE_COST_DECAY;
+		return FALSE;
+	}
+
+	// the cheap pass first, escalating only while there is time left
+	if (filter->dDecodeCost > filter->maxDecodeLatency || filter->dQosProportion > 1.0)
+	{
+		pParams->bAdaptiveEffort = TRUE;
+
+		if (pParams->effortBudget == 0 || pParams->effortBudget > filter->maxDecodeLatency)
+			pParams->effortBudget = filter->maxDecodeLatency;
+	}
+
+	return TRUE;
+}
+
+static GstBarcodeReaderJob* gst_barcode_reader_new_job(GstBarcodeReader* filter)
+{
+	GstBarcodeReaderJob* job;
+
+	g_mutex_lock(&filter->jobPoolLock);
+
+	job = filter->pSpareJobs;
+
+	if (job)
+	{
+		filter->pSpareJobs = job->pNext;
+		filter->uSpareJobs--;
+	}
+
+	g_mutex_unlock(&filter->jobPoolLock);
+
+	if (!job)
+	{
+		job = g_new0(GstBarcodeReaderJob, 1);
+		job->filter = filter;
+		job->pRegions = g_array_new(FALSE, FALSE, sizeof(GstBarcodeReaderRegion));
+	}
+
+	return job;
+}
+
+// finished and dropped jobs go back to the spare list, so a steady stream of
+// frames doesn't allocate
+static void gst_barcode_reader_job_free(gpointer data)
+{
+	GstBarcodeReaderJob* job = (GstBarcodeReaderJob*)data;
+	GstBarcodeReader* filter = job->filter;
+
+	if (job->pBuffer)
+		gst_buffer_unref(job->pBuffer);
+
+	gst_barcode_reader_config_unref(job->pConfig);
+	job->pBuffer = NULL;
+	job->pConfig = NULL;
+
+	g_mutex_lock(&filter->jobPoolLock);
+
+	if (filter->uSpareJobs < MAX_SPARE_JOBS)
+	{
+		job->pNext = filter->pSpareJobs;
+		filter->pSpareJobs = job;
+		filter->uSpareJobs++;
+		job = NULL;
+	}
+
+	g_mutex_unlock(&filter->jobPoolLock);
+
+	if (job)
+	{
+		luma_plane_clear(&job->luma);
+		g_array_unref(job->pRegions);
+		g_free(job);
+	}
+}
+
+static void gst_barcode_reader_run_job(gpointer data, gpointer user_data)
+{
+	GstBarcodeReader* filter = GST_BARCODE_READER(user_data);
+	GstBarcodeReaderJob* job = (GstBarcodeReaderJob*)data;
+	GstVideoFrame frame;
+	GstBarcodeReaderImage image;
+
+	if (job->pBuffer && !gst_video_frame_map(&frame, &job->info, job->pBuffer, GST_MAP_READ))
+	{
+		GST_WARNING_OBJECT(filter, "Failed to map queued frame");
+		return;
+	}
+
+	gint64 startTime = g_get_monotonic_time();
+
+	g_mutex_lock(&filter->decodeLock);
+
+	if (job->pBuffer)
+		gst_barcode_reader_map_image(&frame, job->params.eImageFormat, &image, &filter->jobWork.luma);
+	else
+		image = job->image;
+
+	GPtrArray* pResults = gst_barcode_reader_decode(job->pConfig, &image, &filter->jobWork, &job->params, job->pRegions);
+	g_mutex_unlock(&filter->decodeLock);
+
+	if (job->pBuffer)
+		gst_video_frame_unmap(&frame);
+
+	GstClockTime cost = (g_get_monotonic_time() - startTime) * GST_USECOND;
+
+	GST_OBJECT_LOCK(filter);
+	gst_barcode_reader_update_decode_cost(filter, cost);
+
+	// a frame of the segment before a flush, nobody wants its barcodes anymore
+	if (job->uFlushSeq == filter->uFlushSeq)
+		gst_barcode_reader_handle_barcodes(filter, &filter->jobWork, job->pts, job->runningTime);
+
+	GstMessage* pMessage = gst_barcode_reader_take_message(filter, job->runningTime, FALSE);
+	GST_OBJECT_UNLOCK(filter);
+
+	gst_barcode_reader_emit_report(filter, &filter->jobWork);
+	gst_barcode_reader_post_message(filter, pMessage);
+
+	// the queue runs one job at a time, nothing else touches jobWork's results
+	g_ptr_array_set_size(pResults, 0);
+}
+
+// must be called with the object lock held. With bCopy the overlay is about to
+// be drawn into the frame, the job then decodes a copy of the regions instead
+static void gst_barcode_reader_submit_frame(GstBarcodeReader* filter, GstVideoFrame* frame, GstBarcodeReaderImage* image,
+	const GstBarcodeReaderDecodeParams* pParams, GstClockTime runningTime, gboolean bCopy)
+{
+	if (!filter->pDecodeQueue)
+	{
+		filter->pDecodeQueue = decode_queue_new(gst_barcode_reader_run_job, gst_barcode_reader_job_free, filter);
+		decode_queue_set_policy(filter->pDecodeQueue, filter->eQueuePolicy, filter->uMaxQueuedFrames);
+	}
+
+	GstBarcodeReaderJob* job = gst_barcode_reader_new_job(filter);
+
+	job->info = frame->info;
+	job->params = *pParams;
+	job->pConfig = gst_barcode_reader_get_config(filter);
+	g_array_set_size(job->pRegions, 0);
+	g_array_append_vals(job->pRegions, filter->pFrameRegions->data, filter->pFrameRegions->len);
+
+	if (bCopy)
+		gst_barcode_reader_copy_luma(gst_barcode_reader_frame_image(filter, frame, image), job->pRegions, &job->luma, &job->image);
+	else
+		job->pBuffer = gst_buffer_ref(frame->buffer);
+
+	job->pts = GST_BUFFER_PTS(frame->buffer);
+	job->runningTime = runningTime;
+	job->uFlushSeq = filter->uFlushSeq;
+
+	if (!decode_queue_push(filter->pDecodeQueue, job, &job->link))
+		GST_LOG_OBJECT(filter, "Decode worker busy, dropped frame");
+}
+
+// must be called with the object lock held
+static void gst_barcode_reader_attach_meta(GstBarcodeReader* filter, GstBuffer* buffer)
+{
+	if (!filter->bMetaPending)
+		return;
+
+	if (!gst_buffer_is_writable(buffer))
+	{
+		GST_WARNING_OBJECT(filter, "Buffer not writable, can't attach barcode meta");
+		return;
+	}
+
+	filter->bMetaPending = FALSE;
+
+	if (filter->bAttachMeta)
+	{
+		GstBarcodeMeta* meta = gst_buffer_add_barcode_meta(buffer, filter->metaPts);
+
+		for (guint i = 0; i < filter->pMetaBarcodes->len; i++)
+		{
+			GstBarcodeMetaEntry* entry = &g_array_index(filter->pMetaBarcodes, GstBarcodeMetaEntry, i);
+			gst_barcode_meta_add_barcode(meta, entry->text, entry->format, entry->position);
+		}
+	}
+
+	if (filter->bAttachRoiMeta)
+	{
+		for (guint i = 0; i < filter->pMetaBarcodes->len; i++)
+		{
+			GstBarcodeMetaEntry* entry = &g_array_index(filter->pMetaBarcodes, GstBarcodeMetaEntry, i);
+			ZXing_Position* p = &entry->position;
+			gint x0 = MAX(MIN(MIN(p->topLeft.x, p->topRight.x), MIN(p->bottomLeft.x, p->bottomRight.x)), 0);
+			gint y0 = MAX(MIN(MIN(p->topLeft.y, p->topRight.y), MIN(p->bottomLeft.y, p->bottomRight.y)), 0);
+			gint x1 = MAX(MAX(p->topLeft.x, p->topRight.x), MAX(p->bottomLeft.x, p->bottomRight.x));
+			gint y1 = MAX(MAX(p->topLeft.y, p->topRight.y), MAX(p->bottomLeft.y, p->bottomRight.y));
+
+			GstVideoRegionOfInterestMeta* roi = gst_buffer_add_video_region_of_interest_meta(buffer, "barcode",
+				x0, y0, MAX(x1 - x0 + 1, 1), MAX(y1 - y0 + 1, 1));
+
+			gst_video_region_of_interest_meta_add_param(roi, gst_structure_new(
+				"barcode",
+				"text", G_TYPE_STRING, entry->text,
+				"format", G_TYPE_STRING, entry->format,
+				"pts", G_TYPE_UINT64, filter->metaPts, NULL));
+		}
+	}
+}
+
+static GstFlowReturn gst_barcode_reader_prepare_output_buffer(GstBaseTransform* trans, GstBuffer* inbuf, GstBuffer** outbuf)
+{
+	GstBarcodeReader* filter = GST_BARCODE_READER(trans);
+	GstFlowReturn ret = GST_BASE_TRANSFORM_CLASS(parent_class)->prepare_output_buffer(trans, inbuf, outbuf);
+
+	if (ret != GST_FLOW_OK || *outbuf != inbuf || gst_buffer_is_writable(inbuf))
+		return ret;
+
+	GST_OBJECT_LOCK(filter);
+	gboolean bNeedsMeta = filter->bAttachMeta || filter->bAttachRoiMeta;
+	GST_OBJECT_UNLOCK(filter);
+
+	// passthrough hands us the shared input, a shallow copy makes the metadata
+	// writable while the memory stays shared and mapped read-only
+	if (bNeedsMeta)
+		*outbuf = gst_buffer_copy(inbuf);
+
+	return ret;
+}
+
+static GstFlowReturn gst_barcode_reader_transform_frame_ip (GstVideoFilter * vfilter, GstVideoFrame * frame)
+{
+	GstBarcodeReader *filter = GST_BARCODE_READER (vfilter);
+	gboolean bWritable = (frame->map[0].flags & GST_MAP_WRITE) != 0;
+	GstMessage* pMessage = NULL;
+	GstBarcodeReaderDecodeParams params;
+	GstBarcodeReaderImage image = { NULL };
+
+	if (filter->eImageFormat == ZXing_ImageFormat_None)
+		goto not_negotiated;
+
+	GstClockTime runningTime = gst_barcode_reader_running_time(filter, frame->buffer);
+
+	GST_OBJECT_LOCK(filter);
+
+	if (filter->bEnableReader && filter->uBarcodeFormats != 0)
+	{
+		gst_barcode_reader_collect_regions(filter, frame->buffer);
+		gst_barcode_reader_get_decode_params(filter, &params);
+
+		if (!gst_barcode_reader_should_decode(filter, runningTime))
+		{
+			GST_LOG_OBJECT(filter, "Skipping decode of frame");
+		}
+		else if (!gst_barcode_reader_check_deadline(filter, runningTime, &params))
+		{
+			GST_LOG_OBJECT(filter, "Decode would miss the deadline, skipping frame");
+		}
+		else if (!gst_barcode_reader_motion_gate(filter, frame, &image))
+		{
+			GST_LOG_OBJECT(filter, "No motion, skipping decode of frame");
+		}
+		else if (!gst_barcode_reader_track_regions(filter, runningTime))
+		{
+			GST_LOG_OBJECT(filter, "Tracked barcodes left the frame, skipping decode");
+			filter->bFullScanPending = TRUE;
+		}
+		else if (filter->bAsyncDecode)
+		{
+			gst_barcode_reader_count_pyramid_scan(filter, &params);
+			gst_barcode_reader_submit_frame(filter, frame, &image, &params, runningTime,
+				bWritable && gst_barcode_reader_draws_overlay(filter));
+		}
+		else
+		{
+			gst_barcode_reader_count_pyramid_scan(filter, &params);
+
+			GstBarcodeReaderConfig* pConfig = gst_barcode_reader_get_config(filter);
+			const GstBarcodeReaderImage* pImage = gst_barcode_reader_frame_image(filter, frame, &image);
+
+			// the frame regions and streamWork belong to this thread, property
+			// access must not wait for the decode
+			GST_OBJECT_UNLOCK(filter);
+
+			gint64 startTime = g_get_monotonic_time();
+			GPtrArray* pResults = gst_barcode_reader_decode(pConfig, pImage, &filter->streamWork, &params, filter->pFrameRegions);
+			GstClockTime cost = (g_get_monotonic_time() - startTime) * GST_USECOND;
+
+			gst_barcode_reader_config_unref(pConfig);
+
+			GST_OBJECT_LOCK(filter);
+
+			gst_barcode_reader_update_decode_cost(filter, cost);
+
+			gst_barcode_reader_handle_barcodes(filter, &filter->streamWork, GST_BUFFER_PTS(frame->buffer), runningTime);
+			g_ptr_array_set_size(pResults, 0);
+		}
+
+		// a property change may not have switched passthrough off yet, never draw into a read-only map
+		if (bWritable)
+		{
+			if (filter->pRegions->len > 0 || (filter->bUseRoiMeta && filter->bShowLocation))
+			{
+				for (guint i = 0; i < filter->pFrameRegions->len; i++)
+					gst_barcode_reader_draw_region(filter->pOverlay, &g_array_index(filter->pFrameRegions, GstBarcodeReaderRegion, i));
+			}
+			else if (filter->uCoiStartX > 0 || (filter->uCoiWidth > 0 && filter->uCoiWidth != filter->width))
+			{
+				draw_column(filter->pOverlay, filter->uCoiStartX, filter->uCoiStartX + filter->uCoiWidth - 1, filter->height);
+			}
+
+			// in async mode these are the positions of the most recently decoded frame
+			if (filter->bShowLocation)
+			{
+				for (guint i = 0; i < filter->pPositions->len; i++)
+				{
+					if (filter->uOverlayFillAlpha > 0)
+						gst_barcode_reader_fill_barcode(filter->pOverlay, &g_array_index(filter->pPositions, ZXing_Position, i), filter->uOverlayFillAlpha);
+
+					draw_quad(filter->pOverlay, g_array_index(filter->pPositions, ZXing_Position, i));
+				}
+			}
+
+			overlay_render(filter->pOverlay, frame);
+		}
+
+		gst_barcode_reader_attach_meta(filter, frame->buffer);
+	}
+
+	if (filter->pMessageBarcodes->len)
+		filter->uMessageBatchedFrames++;
+
+	pMessage = gst_barcode_reader_take_message(filter, runningTime, FALSE);
+
+	GST_OBJECT_UNLOCK(filter);
+
+	gst_barcode_reader_emit_report(filter, &filter->streamWork);
+	gst_barcode_reader_post_message(filter, pMessage);
+
+	return GST_FLOW_OK;
+
+not_negotiated:
+	GST_ERROR_OBJECT (filter, "Not negotiated yet");
+	return GST_FLOW_NOT_NEGOTIATED;
+}
+
+// must be called with the object lock held
+static void gst_barcode_reader_set_regions(GstBarcodeReader* filter, const GValue* value)
+{
+	g_array_set_size(filter->pRegions, 0);
+
+	for (guint i = 0; i < gst_value_array_get_size(value); i++)
+	{
+		const GValue* roi = gst_value_array_get_value(value, i);
+		GstBarcodeReaderRegion region;
+
+		if (!GST_VALUE_HOLDS_ARRAY(roi) || gst_value_array_get_size(roi) != 4)
+		{
+			GST_WARNING_OBJECT(filter, "Ignoring ROI %u, expected <x, y, width, height>", i);
+			continue;
+		}
+
+		region.x = g_value_get_int(gst_value_array_get_value(roi, 0));
+		region.y = g_value_get_int(gst_value_array_get_value(roi, 1));
+		region.width = g_value_get_int(gst_value_array_get_value(roi, 2));
+		region.height = g_value_get_int(gst_value_array_get_value(roi, 3));
+
+		if (region.x < 0 || region.y < 0 || region.width <= 0 || region.height <= 0)
+		{
+			GST_WARNING_OBJECT(filter, "Ignoring empty ROI %u", i);
+			continue;
+		}
+
+		g_array_append_val(filter->pRegions, region);
+	}
+}
+
+// must be called with the object lock held
+static void gst_barcode_reader_get_regions(GstBarcodeReader* filter, GValue* value)
+{
+	for (guint i = 0; i < filter->pRegions->len; i++)
+	{
+		GstBarcodeReaderRegion* region = &g_array_index(filter->pRegions, GstBarcodeReaderRegion, i);
+		gint coords[] = { region->x, region->y, region->width, region->height };
+		GValue roi = G_VALUE_INIT;
+
+		g_value_init(&roi, GST_TYPE_ARRAY);
+
+		for (guint j = 0; j < G_N_ELEMENTS(coords); j++)
+		{
+			GValue coord = G_VALUE_INIT;
+
+			g_value_init(&coord, G_TYPE_INT);
+			g_value_set_int(&coord, coords[j]);
+			gst_value_array_append_and_take_value(&roi, &coord);
+		}
+
+		gst_value_array_append_and_take_value(value, &roi);
+	}
+}
+
+static void gst_barcode_reader_set_property(GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec)
+{
+	GstBarcodeReader *filter = GST_BARCODE_READER (object);
+
+	// the pool belongs to the process rather than to this element, warn outside the lock
+	if (prop_id == PROP_DECODE_THREADS)
+	{
+		if (!decode_queue_set_pool_size(g_value_get_uint(value)))
+			GST_WARNING_OBJECT(filter, "decode-threads=%u only applies once every barcode reader has stopped, "
+				"the shared decode pool is running", g_value_get_uint(value));
+		return;
+	}
+
+	GST_OBJECT_LOCK(filter);
+
+	switch (prop_id)
+	{
+	case PROP_BARCODE_FORMATS:
+		filter->uBarcodeFormats = g_value_get_flags(value);
+		gst_barcode_reader_update_config(filter);
+		break;
+
+	case PROP_ENABLE_READER:
+		filter->bEnableReader = g_value_get_boolean(value);
+		break;
+
+	case PROP_SHOW_LOCATION:
+		filter->bShowLocation = g_value_get_boolean(value);
+		break;
+
+	case PROP_COI_START_X:
+		filter->uCoiStartX = g_value_get_uint(value);
+		break;
+
+	case PROP_COI_WIDTH:
+		filter->uCoiWidth = g_value_get_uint(value);
+		break;
+
+	case PROP_ASYNC_DECODE:
+		filter->bAsyncDecode = g_value_get_boolean(value);
+		break;
+
+	case PROP_QUEUE_POLICY:
+		filter->eQueuePolicy = g_value_get_enum(value);
+		if (filter->pDecodeQueue)
+			decode_queue_set_policy(filter->pDecodeQueue, filter->eQueuePolicy, filter->uMaxQueuedFrames);
+		break;
+
+	case PROP_MAX_QUEUED_FRAMES:
+		filter->uMaxQueuedFrames = g_value_get_uint(value);
+		if (filter->pDecodeQueue)
+			decode_queue_set_policy(filter->pDecodeQueue, filter->eQueuePolicy, filter->uMaxQueuedFrames);
+		break;
+
+	case PROP_DECODE_INTERVAL:
+		filter->uDecodeInterval = g_value_get_uint(value);
+		break;
+
+	case PROP_MAX_DECODE_FPS:
+		filter->dMaxDecodeFps = g_value_get_double(value);
+		break;
+
+	case PROP_ADAPTIVE_DECODE:
+		filter->bAdaptiveDecode = g_value_get_boolean(value);
+		gst_barcode_reader_reset_cadence(filter);
+		break;
+
+	case PROP_ADAPTIVE_MAX_INTERVAL:
+		filter->uAdaptiveMaxInterval = g_value_get_uint(value);
+		break;
+
+	case PROP_ADAPTIVE_IDLE_FRAMES:
+		filter->uAdaptiveIdleFrames = g_value_get_uint(value);
+		break;
+
+	case PROP_ATTACH_META:
+		filter->bAttachMeta = g_value_get_boolean(value);
+		break;
+
+	case PROP_ATTACH_ROI_META:
+		filter->bAttachRoiMeta = g_value_get_boolean(value);
+		break;
+
+	case PROP_EMIT_SIGNALS:
+		filter->bEmitSignals = g_value_get_boolean(value);
+		break;
+
+	case PROP_POST_MESSAGES:
+		filter->bPostMessages = g_value_get_boolean(value);
+		break;
+
+	case PROP_MESSAGE_BATCH_FRAMES:
+		filter->uMessageBatchFrames = g_value_get_uint(value);
+		break;
+
+	case PROP_MESSAGE_BATCH_TIME:
+		filter->messageBatchTime = g_value_get_uint64(value);
+		break;
+
+	case PROP_DEDUP_TTL:
+		filter->dedupTtl = g_value_get_uint64(value);
+		break;
+
+	case PROP_DEDUP_CAPACITY:
+		filter->uDedupCapacity = g_value_get_uint(value);
+		barcode_cache_set_capacity(filter->pBarcodeCache, filter->uDedupCapacity);
+		break;
+
+	case PROP_ROI_LIST:
+		gst_barcode_reader_set_regions(filter, value);
+		break;
+
+	case PROP_MOTION_THRESHOLD:
+		filter->uMotionThreshold = g_value_get_uint(value);
+		motion_gate_reset(filter->pMotionGate);
+		break;
+
+	case PROP_MOTION_RESTRICT:
+		filter->bMotionRestrict = g_value_get_boolean(value);
+		break;
+
+	case PROP_TRACKING:
+		filter->bTracking = g_value_get_boolean(value);
+		barcode_tracker_reset(filter->pTracker);
+		break;
+
+	case PROP_TRACKING_FULL_SCAN_INTERVAL:
+		filter->uFullScanInterval = g_value_get_uint(value);
+		break;
+
+	case PROP_PYRAMID_FACTOR:
+		filter->uPyramidFactor = g_value_get_uint(value);
+		break;
+
+	case PROP_MAX_CANDIDATES:
+		filter->uMaxCandidates = g_value_get_uint(value);
+		break;
+
+	case PROP_PYRAMID_FULL_SCAN_INTERVAL:
+		filter->uPyramidFullScanInterval = g_value_get_uint(value);
+		break;
+
+	case PROP_ADAPTIVE_EFFORT:
+		filter->bAdaptiveEffort = g_value_get_boolean(value);
+		break;
+
+	case PROP_EFFORT_BUDGET:
+		filter->effortBudget = g_value_get_uint64(value);
+		break;
+
+	case PROP_MAX_DECODE_LATENCY:
+		filter->maxDecodeLatency = g_value_get_uint64(value);
+		break;
+
+	case PROP_OVERLAY_THICKNESS:
+		filter->uOverlayThickness = g_value_get_uint(value);
+		overlay_set_thickness(filter->pOverlay, filter->uOverlayThickness);
+		break;
+
+	case PROP_OVERLAY_FILL_ALPHA:
+		filter->uOverlayFillAlpha = g_value_get_uint(value);
+		break;
+
+	case PROP_PRESET:
+		gst_barcode_reader_apply_preset(filter, g_value_get_enum(value));
+		gst_barcode_reader_update_config(filter);
+		break;
+
+	case PROP_TRY_HARDER:
+		filter->bTryHarder = g_value_get_boolean(value);
+		filter->ePreset = GST_BARCODE_READER_PRESET_CUSTOM;
+		gst_barcode_reader_update_config(filter);
+		break;
+
+	case PROP_TRY_ROTATE:
+		filter->bTryRotate = g_value_get_boolean(value);
+		filter->ePreset = GST_BARCODE_READER_PRESET_CUSTOM;
+		gst_barcode_reader_update_config(filter);
+		break;
+
+	case PROP_TRY_INVERT:
+		filter->bTryInvert = g_value_get_boolean(value);
+		filter->ePreset = GST_BARCODE_READER_PRESET_CUSTOM;
+		gst_barcode_reader_update_config(filter);
+		break;
+
+	case PROP_TRY_DOWNSCALE:
+		filter->bTryDownscale = g_value_get_boolean(value);
+		filter->ePreset = GST_BARCODE_READER_PRESET_CUSTOM;
+		gst_barcode_reader_update_config(filter);
+		break;
+
+	case PROP_BINARIZER:
+		filter->eBinarizer = g_value_get_enum(value);
+		filter->ePreset = GST_BARCODE_READER_PRESET_CUSTOM;
+		gst_barcode_reader_update_config(filter);
+		break;
+
+	case PROP_IS_PURE:
+		filter->bIsPure = g_value_get_boolean(value);
+		filter->ePreset = GST_BARCODE_READER_PRESET_CUSTOM;
+		gst_barcode_reader_update_config(filter);
+		break;
+
+	case PROP_MIN_LINE_COUNT:
+		filter->iMinLineCount = g_value_get_int(value);
+		filter->ePreset = GST_BARCODE_READER_PRESET_CUSTOM;
+		gst_barcode_reader_update_config(filter);
+		break;
+
+	case PROP_MAX_NUMBER_OF_SYMBOLS:
+		filter->iMaxNumberOfSymbols = g_value_get_int(value);
+		filter->ePreset = GST_BARCODE_READER_PRESET_CUSTOM;
+		gst_barcode_reader_update_config(filter);
+		break;
+
+	case PROP_USE_ROI_META:
+		filter->bUseRoiMeta = g_value_get_boolean(value);
+		break;
+
+	case PROP_PARALLEL_ROI:
+		filter->bParallelRoi = g_value_get_boolean(value);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(filter);
+
+	gst_barcode_reader_update_passthrough(filter);
+}
+
+static void gst_barcode_reader_get_property(GObject * object, guint prop_id, GValue * value, GParamSpec * pspec)
+{
+	GstBarcodeReader* filter = GST_BARCODE_READER(object);
+
+	GST_OBJECT_LOCK(filter);
+
+	switch (prop_id) 
+	{
+	case PROP_BARCODE_FORMATS:
+		g_value_set_flags(value, filter->uBarcodeFormats);
+		break;
+	
+	case PROP_ENABLE_READER:
+		g_value_set_boolean(value, filter->bEnableReader);
+		break;
+
+	case PROP_SHOW_LOCATION:
+		g_value_set_boolean(value, filter->bShowLocation);
+		break;
+
+	case PROP_COI_START_X:
+		g_value_set_uint(value, filter->uCoiStartX);
+		break;
+
+	case PROP_COI_WIDTH:
+		g_value_set_uint(value, filter->uCoiWidth);
+		break;
+
+	case PROP_ASYNC_DECODE:
+		g_value_set_boolean(value, filter->bAsyncDecode);
+		break;
+
+	case PROP_QUEUE_POLICY:
+		g_value_set_enum(value, filter->eQueuePolicy);
+		break;
+
+	case PROP_MAX_QUEUED_FRAMES:
+		g_value_set_uint(value, filter->uMaxQueuedFrames);
+		break;
+
+	case PROP_DECODE_THREADS:
+		g_value_set_uint(value, decode_queue_get_pool_size());
+		break;
+
+	case PROP_DECODE_INTERVAL:
+		g_value_set_uint(value, filter->uDecodeInterval);
+		break;
+
+	case PROP_MAX_DECODE_FPS:
+		g_value_set_double(value, filter->dMaxDecodeFps);
+		break;
+
+	case PROP_ADAPTIVE_DECODE:
+		g_value_set_boolean(value, filter->bAdaptiveDecode);
+		break;
+
+	case PROP_ADAPTIVE_MAX_INTERVAL:
+		g_value_set_uint(value, filter->uAdaptiveMaxInterval);
+		break;
+
+	case PROP_ADAPTIVE_IDLE_FRAMES:
+		g_value_set_uint(value, filter->uAdaptiveIdleFrames);
+		break;
+
+	case PROP_ATTACH_META:
+		g_value_set_boolean(value, filter->bAttachMeta);
+		break;
+
+	case PROP_ATTACH_ROI_META:
+		g_value_set_boolean(value, filter->bAttachRoiMeta);
+		break;
+
+	case PROP_EMIT_SIGNALS:
+		g_value_set_boolean(value, filter->bEmitSignals);
+		break;
+
+	case PROP_POST_MESSAGES:
+		g_value_set_boolean(value, filter->bPostMessages);
+		break;
+
+	case PROP_MESSAGE_BATCH_FRAMES:
+		g_value_set_uint(value, filter->uMessageBatchFrames);
+		break;
+
+	case PROP_MESSAGE_BATCH_TIME:
+		g_value_set_uint64(value, filter->messageBatchTime);
+		break;
+
+	case PROP_DEDUP_TTL:
+		g_value_set_uint64(value, filter->dedupTtl);
+		break;
+
+	case PROP_DEDUP_CAPACITY:
+		g_value_set_uint(value, filter->uDedupCapacity);
+		break;
+
+	case PROP_ROI_LIST:
+		gst_barcode_reader_get_regions(filter, value);
+		break;
+
+	case PROP_MOTION_THRESHOLD:
+		g_value_set_uint(value, filter->uMotionThreshold);
+		break;
+
+	case PROP_MOTION_RESTRICT:
+		g_value_set_boolean(value, filter->bMotionRestrict);
+		break;
+
+	case PROP_TRACKING:
+		g_value_set_boolean(value, filter->bTracking);
+		break;
+
+	case PROP_TRACKING_FULL_SCAN_INTERVAL:
+		g_value_set_uint(value, filter->uFullScanInterval);
+		break;
+
+	case PROP_PYRAMID_FACTOR:
+		g_value_set_uint(value, filter->uPyramidFactor);
+		break;
+
+	case PROP_MAX_CANDIDATES:
+		g_value_set_uint(value, filter->uMaxCandidates);
+		break;
+
+	case PROP_PYRAMID_FULL_SCAN_INTERVAL:
+		g_value_set_uint(value, filter->uPyramidFullScanInterval);
+		break;
+
+	case PROP_ADAPTIVE_EFFORT:
+		g_value_set_boolean(value, filter->bAdaptiveEffort);
+		break;
+
+	case PROP_EFFORT_BUDGET:
+		g_value_set_uint64(value, filter->effortBudget);
+		break;
+
+	case PROP_MAX_DECODE_LATENCY:
+		g_value_set_uint64(value, filter->maxDecodeLatency);
+		break;
+
+	case PROP_OVERLAY_THICKNESS:
+		g_value_set_uint(value, filter->uOverlayThickness);
+		break;
+
+	case PROP_OVERLAY_FILL_ALPHA:
+		g_value_set_uint(value, filter->uOverlayFillAlpha);
+		break;
+
+	case PROP_PRESET:
+		g_value_set_enum(value, filter->ePreset);
+		break;
+
+	case PROP_TRY_HARDER:
+		g_value_set_boolean(value, filter->bTryHarder);
+		break;
+
+	case PROP_TRY_ROTATE:
+		g_value_set_boolean(value, filter->bTryRotate);
+		break;
+
+	case PROP_TRY_INVERT:
+		g_value_set_boolean(value, filter->bTryInvert);
+		break;
+
+	case PROP_TRY_DOWNSCALE:
+		g_value_set_boolean(value, filter->bTryDownscale);
+		break;
+
+	case PROP_BINARIZER:
+		g_value_set_enum(value, filter->eBinarizer);
+		break;
+
+	case PROP_IS_PURE:
+		g_value_set_boolean(value, filter->bIsPure);
+		break;
+
+	case PROP_MIN_LINE_COUNT:
+		g_value_set_int(value, filter->iMinLineCount);
+		break;
+
+	case PROP_MAX_NUMBER_OF_SYMBOLS:
+		g_value_set_int(value, filter->iMaxNumberOfSymbols);
+		break;
+
+	case PROP_USE_ROI_META:
+		g_value_set_boolean(value, filter->bUseRoiMeta);
+		break;
+
+	case PROP_PARALLEL_ROI:
+		g_value_set_boolean(value, filter->bParallelRoi);
+		break;
+
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+
+	GST_OBJECT_UNLOCK(filter);
+}
+
+static GType gst_barcode_reader_get_barcode_type(void)
+{
+	static GType barcode_type = 0;
+	if (!barcode_type)
+	{
+		static const GFlagsValue barcode_types[] = {
+			{ ZXing_BarcodeFormat_None, "None", "none" },
+			{ ZXing_BarcodeFormat_Aztec, "Aztec", "aztec" },
+			{ ZXing_BarcodeFormat_Codabar, "Codabar", "codabar" },
+			{ ZXing_BarcodeFormat_Code39, "Code 39", "code-39" },
+			{ ZXing_BarcodeFormat_Code93, "Code 93", "code-93" },
+			{ ZXing_BarcodeFormat_Code128, "Code 128", "code-128" },
+			{ ZXing_BarcodeFormat_DataBar, "Data Bar", "data-bar" },
+			{ ZXing_BarcodeFormat_DataBarExpanded, "Data Bar Expanded", "data-bar-expanded" },
+			{ ZXing_BarcodeFormat_DataMatrix, "Data Matrix", "data-matrix" },
+			{ ZXing_BarcodeFormat_EAN8, "EAN 8", "ean-8" },
+			{ ZXing_BarcodeFormat_EAN13, "EAN 13", "ean-13" },
+			{ ZXing_BarcodeFormat_ITF, "ITF", "itf" },
+			{ ZXing_BarcodeFormat_MaxiCode, "Maxi Code", "maxi-code" },
+			{ ZXing_BarcodeFormat_PDF417, "PDF417", "pdf417" },
+			{ ZXing_BarcodeFormat_QRCode, "QR Code", "qr-code" },
+			{ ZXing_BarcodeFormat_UPCA, "UPCA", "upca" },
+			{ ZXing_BarcodeFormat_UPCE, "UPCE", "upce" },
+			{ ZXing_BarcodeFormat_MicroQRCode, "Micro QR Code", "micro-qr-code" },
+			{ ZXing_BarcodeFormat_RMQRCode, "RM QR Code", "rm-qr-code" },
+			{ ZXing_BarcodeFormat_DXFilmEdge, "DX Film Edge", "dx-film-edge" },
+			{ ZXing_BarcodeFormat_DataBarLimited, "Data Bar Limited", "data-bar-limited" },
+			{ ZXing_BarcodeFormat_LinearCodes, "All Linear Codes", "linear-codes" },
+			{ ZXing_BarcodeFormat_MatrixCodes, "All Matrix Codes", "matrix-codes" },
+			{ ZXing_BarcodeFormat_Any, "Any Code", "any" },
+			{ 0, NULL, NULL }
+		};
+		barcode_type = g_flags_register_static("BarcodeType", barcode_types);
+	}
+	return barcode_type;
+}
+
+static GType gst_barcode_reader_get_queue_policy_type(void)
+{
+	static GType queue_policy_type = 0;
+	if (!queue_policy_type)
+	{
+		static const GEnumValue queue_policies[] = {
+			{ DECODE_QUEUE_POLICY_DROP_NEWEST, "Drop new frames while the decoder is busy", "drop-newest" },
+			{ DECODE_QUEUE_POLICY_DROP_OLDEST, "Replace the pending frame with the newest one", "drop-oldest" },
+			{ DECODE_QUEUE_POLICY_QUEUE, "Queue up to max-queued-frames frames", "queue" },
+			{ 0, NULL, NULL }
+		};
+		queue_policy_type = g_enum_register_static("BarcodeReaderQueuePolicy", queue_policies);
+	}
+	return queue_policy_type;
+}
+
+static GType gst_barcode_reader_get_preset_type(void)
+{
+	static GType preset_type = 0;
+	if (!preset_type)
+	{
+		static const GEnumValue presets[] = {
+			{ GST_BARCODE_READER_PRESET_CUSTOM, "Individually set reader options", "custom" },
+			{ GST_BARCODE_READER_PRESET_FAST, "Upright, non-inverted barcodes only", "fast" },
+			{ GST_BARCODE_READER_PRESET_BALANCED, "Rotated barcodes and downscaling, no extra effort", "balanced" },
+			{ GST_BARCODE_READER_PRESET_THOROUGH, "Everything ZXing can try", "thorough" },
+			{ 0, NULL, NULL }
+		};
+		preset_type = g_enum_register_static("BarcodeReaderPreset", presets);
+	}
+	return preset_type;
+}
+
+static GType gst_barcode_reader_get_binarizer_type(void)
+{
+	static GType binarizer_type = 0;
+	if (!binarizer_type)
+	{
+		static const GEnumValue binarizers[] = {
+			{ ZXing_Binarizer_LocalAverage, "Local average threshold", "local-average" },
+			{ ZXing_Binarizer_GlobalHistogram, "Global histogram threshold", "global-histogram" },
+			{ ZXing_Binarizer_FixedThreshold, "Fixed threshold at 127", "fixed-threshold" },
+			{ ZXing_Binarizer_BoolCast, "Any non-zero value is light", "bool-cast" },
+			{ 0, NULL, NULL }
+		};
+		binarizer_type = g_enum_register_static("BarcodeReaderBinarizer", binarizers);
+	}
+	return binarizer_type;
+}
+
+GType garray_get_type(void)
+{
+	static GType type = 0;
+
+	if (type == 0)
+	{
+		type = g_boxed_type_register_static(
+			"GBarcodeArray",
+			(GBoxedCopyFunc)g_array_ref,
+			(GBoxedFreeFunc)g_array_unref
+		);
+	}
+
+	return type;
+}
+
+static gboolean gst_barcode_reader_start(GstBaseTransform* trans)
+{
+	GstBarcodeReader* filter = GST_BARCODE_READER(trans);
+
+	GST_OBJECT_LOCK(filter);
+	gst_barcode_reader_reset_cadence(filter);
+	barcode_cache_clear(filter->pBarcodeCache);
+	motion_gate_reset(filter->pMotionGate);
+	barcode_tracker_reset(filter->pTracker);
+	gst_barcode_reader_reset_qos(filter);
+	filter->dDecodeCost = -1;
+	GST_OBJECT_UNLOCK(filter);
+
+	return TRUE;
+}
+
+static gboolean gst_barcode_reader_src_event(GstBaseTransform* trans, GstEvent* event)
+{
+	GstBarcodeReader* filter = GST_BARCODE_READER(trans);
+
+	// QoS is left disabled on the base class so late frames still pass, only their decode is skipped
+	if (GST_EVENT_TYPE(event) == GST_EVENT_QOS)
+	{
+		GstQOSType type;
+		gdouble proportion;
+		GstClockTimeDiff diff;
+		GstClockTime timestamp;
+
+		gst_event_parse_qos(event, &type, &proportion, &diff, &timestamp);
+
+		GST_OBJECT_LOCK(filter);
+
+		filter->dQosProportion = proportion;
+
+		// late, skip ahead like the base classes do: twice the lateness plus one frame
+		if (diff > 0 && GST_CLOCK_TIME_IS_VALID(timestamp))
+			filter->qosEarliestTime = timestamp + 2 * diff + filter->frameDuration;
+		else
+			filter->qosEarliestTime = GST_CLOCK_TIME_NONE;
+
+		GST_OBJECT_UNLOCK(filter);
+	}
+
+	return GST_BASE_TRANSFORM_CLASS(parent_class)->src_event(trans, event);
+}
+
+static gboolean gst_barcode_reader_sink_event(GstBaseTransform* trans, GstEvent* event)
+{
+	GstBarcodeReader* filter = GST_BARCODE_READER(trans);
+
+	if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP)
+	{
+		GST_OBJECT_LOCK(filter);
+		gst_barcode_reader_reset_qos(filter);
+		filter->uFlushSeq++;
+		DecodeQueue* pDecodeQueue = filter->pDecodeQueue;
+		GST_OBJECT_UNLOCK(filter);
+
+		// drops the queued frames of the old segment and waits for a running one,
+		// which takes the object lock to finish
+		if (pDecodeQueue)
+			decode_queue_flush(pDecodeQueue);
+	}
+	else if (GST_EVENT_TYPE(event) == GST_EVENT_EOS)
+	{
+		GST_OBJECT_LOCK(filter);
+		GstMessage* pMessage = gst_barcode_reader_take_message(filter, GST_CLOCK_TIME_NONE, TRUE);
+		GST_OBJECT_UNLOCK(filter);
+
+		// deliver the last partial batch before the application sees EOS
+		gst_barcode_reader_post_message(filter, pMessage);
+	}
+
+	return GST_BASE_TRANSFORM_CLASS(parent_class)->sink_event(trans, event);
+}
+
+static gboolean gst_barcode_reader_stop(GstBaseTransform* trans)
+{
+	GstBarcodeReader* filter = GST_BARCODE_READER(trans);
+
+	GST_OBJECT_LOCK(filter);
+	DecodeQueue* pDecodeQueue = filter->pDecodeQueue;
+	filter->pDecodeQueue = NULL;
+	filter->uFlushSeq++;
+	GST_OBJECT_UNLOCK(filter);
+
+	// the worker takes the object lock to report results, so join it unlocked.
+	// Freeing drops the queued frames just like a flush
+	if (pDecodeQueue)
+		decode_queue_free(pDecodeQueue);
+
+	// streaming has stopped and no job is running, drop the batches and with
+	// them the last users of the pool
+	if (filter->streamWork.pBatch)
+	{
+		decode_batch_free(filter->streamWork.pBatch);
+		filter->streamWork.pBatch = NULL;
+	}
+
+	g_mutex_lock(&filter->decodeLock);
+
+	if (filter->jobWork.pBatch)
+	{
+		decode_batch_free(filter->jobWork.pBatch);
+		filter->jobWork.pBatch = NULL;
+	}
+
+	g_mutex_unlock(&filter->decodeLock);
+
+	GST_OBJECT_LOCK(filter);
+	DecodePool* pDecodePool = filter->pDecodePool;
+	filter->pDecodePool = NULL;
+	GST_OBJECT_UNLOCK(filter);
+
+	if (pDecodePool)
+		decode_pool_unref(pDecodePool);
+
+	GST_OBJECT_LOCK(filter);
+	GstMessage* pMessage = gst_barcode_reader_take_message(filter, GST_CLOCK_TIME_NONE, TRUE);
+	GST_OBJECT_UNLOCK(filter);
+
+	gst_barcode_reader_post_message(filter, pMessage);
+
+	return TRUE;
+}
+
+static void gst_barcode_reader_finalize(GObject* object)
+{
+	GstBarcodeReader* filter = GST_BARCODE_READER(object);
+
+	if (filter->pDecodeQueue)
+		decode_queue_free(filter->pDecodeQueue);
+
+	if (filter->pDecodePool)
+		decode_pool_unref(filter->pDecodePool);
+
+	barcode_cache_free(filter->pBarcodeCache);
+
+	if (filter->pConfig)
+		gst_barcode_reader_config_unref(filter->pConfig);
+
+	gst_barcode_reader_workspace_clear(&filter->streamWork);
+	gst_barcode_reader_workspace_clear(&filter->jobWork);
+
+	while (filter->pSpareJobs)
+	{
+		GstBarcodeReaderJob* job = filter->pSpareJobs;
+
+		filter->pSpareJobs = job->pNext;
+		luma_plane_clear(&job->luma);
+		g_array_unref(job->pRegions);
+		g_free(job);
+	}
+
+	g_mutex_clear(&filter->jobPoolLock);
+	g_array_unref(filter->pPositions);
+	g_array_unref(filter->pMetaBarcodes);
+	g_ptr_array_unref(filter->pMessageBarcodes);
+	g_array_unref(filter->pRegions);
+	g_array_unref(filter->pFrameRegions);
+	motion_gate_free(filter->pMotionGate);
+	barcode_tracker_free(filter->pTracker);
+	overlay_free(filter->pOverlay);
+	g_mutex_clear(&filter->decodeLock);
+	g_mutex_clear(&filter->configLock);
+
+	// Chain up to the parent class's finalize method
+	G_OBJECT_CLASS(gst_barcode_reader_parent_class)->finalize(object);
+}
+
+static void gst_barcode_reader_class_init (GstBarcodeReaderClass * klass)
 {
 	GObjectClass* gobject_class = (GObjectClass*)klass;
 	GstElementClass* element_class = (GstElementClass*)klass;
+	GstBaseTransformClass* trans_class = (GstBaseTransformClass*)klass;
 	GstVideoFilterClass* vfilter_class = (GstVideoFilterClass*)klass;
 
 	GST_DEBUG_CATEGORY_INIT(barcodereader_debug, "barcodereader", 0, "barcodereader");
 
 	gobject_class->set_property = gst_barcode_reader_set_property;
 	gobject_class->get_property = gst_barcode_reader_get_property;
+	gobject_class->finalize = gst_barcode_reader_finalize;
 
 	g_object_class_install_property(
 		gobject_class, 
@@ -450,7 +2342,7 @@ static void gst_barcode_reader_class_init (GstBarcodeReaderClass * klass)
 		g_param_spec_boolean(
 			"show-location",
 			"Show Location",
-			"Show location of barcodes in image",
+			"Show location of barcodes in image. Without overlays the element runs as an analysis-only passthrough",
 			TRUE,
 			G_PARAM_READWRITE));
 
@@ -478,6 +2370,472 @@ static void gst_barcode_reader_class_init (GstBarcodeReaderClass * klass)
 			0,
 			G_PARAM_READWRITE));
 
+	g_object_class_install_property(
+		gobject_class,
+		PROP_ASYNC_DECODE,
+		g_param_spec_boolean(
+			"async-decode",
+			"Async Decode",
+			"Decode frames on the shared decode thread pool and pass buffers through immediately. "
+			"barcode-signal is then emitted from a decode thread",
+			FALSE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_QUEUE_POLICY,
+		g_param_spec_enum(
+			"queue-policy",
+			"Queue Policy",
+			"What to do with new frames while the async decoder is busy",
+			gst_barcode_reader_get_queue_policy_type(),
+			DECODE_QUEUE_POLICY_DROP_OLDEST,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_MAX_QUEUED_FRAMES,
+		g_param_spec_uint(
+			"max-queued-frames",
+			"Max Queued Frames",
+			"Maximum number of frames waiting for the async decoder with queue-policy=queue",
+			1,
+			64,
+			4,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_DECODE_THREADS,
+		g_param_spec_uint(
+			"decode-threads",
+			"Decode Threads",
+			"Size of the decode thread pool shared by every barcode reader in the process, setting it on "
+			"one element changes it for all of them (0 = BARCODE_READER_DECODE_THREADS or number of CPUs). "
+			"Set it before the first reader starts, a running pool keeps its size until all readers have stopped. "
+			"Only async-decode bounds the decode load by the pool, without it every reader decodes on its own "
+			"streaming thread and parallel-roi adds the pool threads to that",
+			0,
+			256,
+			0,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_DECODE_INTERVAL,
+		g_param_spec_uint(
+			"decode-interval",
+			"Decode Interval",
+			"Decode every Nth frame",
+			1,
+			UINT_MAX,
+			1,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_MAX_DECODE_FPS,
+		g_param_spec_double(
+			"max-decode-fps",
+			"Max Decode FPS",
+			"Maximum number of decoded frames per second of running time (0 = unlimited)",
+			0,
+			G_MAXDOUBLE,
+			0,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_ADAPTIVE_DECODE,
+		g_param_spec_boolean(
+			"adaptive-decode",
+			"Adaptive Decode",
+			"Decode every frame while barcodes are found and back off exponentially while none are",
+			FALSE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_ADAPTIVE_MAX_INTERVAL,
+		g_param_spec_uint(
+			"adaptive-max-interval",
+			"Adaptive Max Interval",
+			"Largest frame interval the adaptive mode backs off to",
+			1,
+			UINT_MAX,
+			8,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_ADAPTIVE_IDLE_FRAMES,
+		g_param_spec_uint(
+			"adaptive-idle-frames",
+			"Adaptive Idle Frames",
+			"Number of decodes without barcodes before the adaptive interval is doubled",
+			1,
+			UINT_MAX,
+			10,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_ATTACH_META,
+		g_param_spec_boolean(
+			"attach-meta",
+			"Attach Meta",
+			"Attach a GstBarcodeMeta with all barcodes found in a frame to the output buffer",
+			FALSE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_ATTACH_ROI_META,
+		g_param_spec_boolean(
+			"attach-roi-meta",
+			"Attach ROI Meta",
+			"Attach a GstVideoRegionOfInterestMeta of type \"barcode\" per barcode found in a frame",
+			FALSE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_EMIT_SIGNALS,
+		g_param_spec_boolean(
+			"emit-signals",
+			"Emit Signals",
+			"Emit barcode-signal for new barcodes",
+			TRUE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_POST_MESSAGES,
+		g_param_spec_boolean(
+			"post-messages",
+			"Post Messages",
+			"Post new barcodes as \"barcode\" element messages on the bus",
+			FALSE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_MESSAGE_BATCH_FRAMES,
+		g_param_spec_uint(
+			"message-batch-frames",
+			"Message Batch Frames",
+			"Coalesce barcodes over this many frames into one bus message (0 = disabled)",
+			0,
+			UINT_MAX,
+			0,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_MESSAGE_BATCH_TIME,
+		g_param_spec_uint64(
+			"message-batch-time",
+			"Message Batch Time",
+			"Coalesce barcodes over this many nanoseconds of running time into one bus message (0 = disabled)",
+			0,
+			G_MAXUINT64,
+			0,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_DEDUP_TTL,
+		g_param_spec_uint64(
+			"dedup-ttl",
+			"Dedup TTL",
+			"Report a barcode again only after it was not seen for this many nanoseconds of running time",
+			0,
+			G_MAXUINT64,
+			2 * GST_SECOND,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_DEDUP_CAPACITY,
+		g_param_spec_uint(
+			"dedup-capacity",
+			"Dedup Capacity",
+			"Maximum number of barcodes remembered for deduplication, least recently seen are evicted first",
+			1,
+			UINT_MAX,
+			256,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_ROI_LIST,
+		gst_param_spec_array(
+			"roi-list",
+			"ROI List",
+			"Regions of interest to decode instead of the column of interest, e.g. <<x, y, width, height>, ...>",
+			gst_param_spec_array(
+				"roi",
+				"ROI",
+				"Region of interest as <x, y, width, height>",
+				g_param_spec_int("coord", "Coordinate", "ROI coordinate", 0, G_MAXINT, 0, G_PARAM_READWRITE),
+				G_PARAM_READWRITE),
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_USE_ROI_META,
+		g_param_spec_boolean(
+			"use-roi-meta",
+			"Use ROI Meta",
+			"Also decode the regions of upstream GstVideoRegionOfInterestMeta",
+			FALSE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_PARALLEL_ROI,
+		g_param_spec_boolean(
+			"parallel-roi",
+			"Parallel ROI",
+			"Decode the regions of a frame in parallel on the decode threads",
+			FALSE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_MOTION_THRESHOLD,
+		g_param_spec_uint(
+			"motion-threshold",
+			"Motion Threshold",
+			"Skip decoding while no 128x128 tile differs by at least this mean luma from the last decoded frame (0 = disabled)",
+			0,
+			255,
+			0,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_MOTION_RESTRICT,
+		g_param_spec_boolean(
+			"motion-restrict",
+			"Motion Restrict",
+			"Only decode around the changed tiles when motion-threshold is set",
+			FALSE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_TRACKING,
+		g_param_spec_boolean(
+			"tracking",
+			"Tracking",
+			"Follow found barcodes and only decode around their predicted positions between full scans",
+			FALSE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_TRACKING_FULL_SCAN_INTERVAL,
+		g_param_spec_uint(
+			"tracking-full-scan-interval",
+			"Tracking Full Scan Interval",
+			"Scan all regions every n-th decoded frame while tracking",
+			1,
+			UINT_MAX,
+			10,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_PYRAMID_FACTOR,
+		g_param_spec_uint(
+			"pyramid-factor",
+			"Pyramid Factor",
+			"Find barcodes on a copy downscaled by this power of two first and decode only their surroundings at full resolution (1 = disabled)",
+			1,
+			16,
+			1,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_MAX_CANDIDATES,
+		g_param_spec_uint(
+			"max-candidates",
+			"Max Candidates",
+			"Maximum number of barcode candidates of the pyramid pass decoded at full resolution",
+			1,
+			UINT_MAX,
+			8,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_PYRAMID_FULL_SCAN_INTERVAL,
+		g_param_spec_uint(
+			"pyramid-full-scan-interval",
+			"Pyramid Full Scan Interval",
+			"Decode the whole regions at full resolution on every Nth decoded frame on which the pyramid pass found no candidates (0 = never)",
+			0,
+			UINT_MAX,
+			10,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_PRESET,
+		g_param_spec_enum(
+			"preset",
+			"Preset",
+			"Sets try-harder, try-rotate, try-invert and try-downscale for a speed/recall trade-off",
+			gst_barcode_reader_get_preset_type(),
+			GST_BARCODE_READER_PRESET_THOROUGH,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_TRY_HARDER,
+		g_param_spec_boolean(
+			"try-harder",
+			"Try Harder",
+			"Spend more time to find barcodes, slower but finds more",
+			TRUE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_TRY_ROTATE,
+		g_param_spec_boolean(
+			"try-rotate",
+			"Try Rotate",
+			"Also look for barcodes rotated by 90, 180 and 270 degrees",
+			TRUE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_TRY_INVERT,
+		g_param_spec_boolean(
+			"try-invert",
+			"Try Invert",
+			"Also look for inverted (light on dark) barcodes",
+			TRUE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_TRY_DOWNSCALE,
+		g_param_spec_boolean(
+			"try-downscale",
+			"Try Downscale",
+			"Also look for barcodes in downscaled copies of large images",
+			TRUE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_BINARIZER,
+		g_param_spec_enum(
+			"binarizer",
+			"Binarizer",
+			"Algorithm used to separate dark from light pixels",
+			gst_barcode_reader_get_binarizer_type(),
+			ZXing_Binarizer_LocalAverage,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_IS_PURE,
+		g_param_spec_boolean(
+			"is-pure",
+			"Is Pure",
+			"Assume the image contains a single unrotated barcode and nothing else",
+			FALSE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_MIN_LINE_COUNT,
+		g_param_spec_int(
+			"min-line-count",
+			"Min Line Count",
+			"Number of scan lines a linear barcode has to be found on to be accepted",
+			1,
+			G_MAXINT,
+			2,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_MAX_NUMBER_OF_SYMBOLS,
+		g_param_spec_int(
+			"max-number-of-symbols",
+			"Max Number Of Symbols",
+			"Stop looking once this many barcodes have been found in a frame",
+			1,
+			255,
+			255,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_ADAPTIVE_EFFORT,
+		g_param_spec_boolean(
+			"adaptive-effort",
+			"Adaptive Effort",
+			"Decode with cheap options first and only retry with the configured ones where a barcode was seen but not decoded",
+			FALSE,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_EFFORT_BUDGET,
+		g_param_spec_uint64(
+			"effort-budget",
+			"Effort Budget",
+			"Don't start retries once a frame took this many nanoseconds to decode (0 = unlimited)",
+			0,
+			G_MAXUINT64,
+			0,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_MAX_DECODE_LATENCY,
+		g_param_spec_uint64(
+			"max-decode-latency",
+			"Max Decode Latency",
+			"Downgrade to cheap decoding while the average decode takes longer than this many nanoseconds "
+			"and skip frames at twice that (0 = disabled)",
+			0,
+			G_MAXUINT64,
+			0,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_OVERLAY_THICKNESS,
+		g_param_spec_uint(
+			"overlay-thickness",
+			"Overlay Thickness",
+			"Width in pixels of the drawn outlines",
+			1,
+			64,
+			1,
+			G_PARAM_READWRITE));
+
+	g_object_class_install_property(
+		gobject_class,
+		PROP_OVERLAY_FILL_ALPHA,
+		g_param_spec_uint(
+			"overlay-fill-alpha",
+			"Overlay Fill Alpha",
+			"Opacity of the box filled over each located barcode (0 = outline only, 255 = opaque)",
+			0,
+			255,
+			0,
+			G_PARAM_READWRITE));
+
 	gst_barcode_reader_signals[BARCODE_SIGNAL] = g_signal_new(
 		"barcode-signal",                   // Signal name
 		G_TYPE_FROM_CLASS(klass),           // Signal owner type
@@ -491,6 +2849,12 @@ static void gst_barcode_reader_class_init (GstBarcodeReaderClass * klass)
 		garray_get_type()					// Parameter type: GArray of GstStructure*
 	);
 	
+	trans_class->start = GST_DEBUG_FUNCPTR(gst_barcode_reader_start);
+	trans_class->sink_event = GST_DEBUG_FUNCPTR(gst_barcode_reader_sink_event);
+	trans_class->src_event = GST_DEBUG_FUNCPTR(gst_barcode_reader_src_event);
+	trans_class->prepare_output_buffer = GST_DEBUG_FUNCPTR(gst_barcode_reader_prepare_output_buffer);
+	trans_class->stop = GST_DEBUG_FUNCPTR(gst_barcode_reader_stop);
+
 	vfilter_class->set_info = GST_DEBUG_FUNCPTR(gst_barcode_reader_set_info);
 	vfilter_class->transform_frame_ip = GST_DEBUG_FUNCPTR(gst_barcode_reader_transform_frame_ip);
 
@@ -507,25 +2871,78 @@ static void gst_barcode_reader_class_init (GstBarcodeReaderClass * klass)
 	//gst_type_mark_as_plugin_api(GST_TYPE_BARCODE_READER_PRESET, 0);
 }
 
-static void gst_barcode_reader_finalize(GObject* object)
-{
-	GstBarcodeReader* filter = GST_BARCODE_READER(object);
-
-	// Chain up to the parent class's finalize method
-	G_OBJECT_CLASS(gst_barcode_reader_parent_class)->finalize(object);
-}
-
 static void gst_barcode_reader_init(GstBarcodeReader* filter)
 {
-	GObjectClass* gobject_class = G_OBJECT_CLASS(filter);
-	//gobject_class->finalize = gst_barcode_reader_finalize;
 	filter->eImageFormat = ZXing_ImageFormat_None;
 	filter->uBarcodeFormats = ZXing_BarcodeFormat_Any;
+	gst_barcode_reader_apply_preset(filter, GST_BARCODE_READER_PRESET_THOROUGH);
+	filter->eBinarizer = ZXing_Binarizer_LocalAverage;
+	filter->bIsPure = FALSE;
+	filter->iMinLineCount = 2;
+	filter->iMaxNumberOfSymbols = 255;
 	filter->bShowLocation = TRUE;
 	filter->bEnableReader = TRUE;
 	filter->uCoiStartX = 0;
 	filter->uCoiWidth = 0;
-	filter->pBarcodes = NULL;
-	filter->pOpts = NULL;
-	filter->prevBarcodeTime = 0;
+	filter->pBarcodeCache = barcode_cache_new(256);
+	filter->dedupTtl = 2 * GST_SECOND;
+	filter->uDedupCapacity = 256;
+	filter->pConfig = NULL;
+	g_mutex_init(&filter->configLock);
+	filter->pPositions = g_array_new(FALSE, FALSE, sizeof(ZXing_Position));
+	filter->bAsyncDecode = FALSE;
+	filter->eQueuePolicy = DECODE_QUEUE_POLICY_DROP_OLDEST;
+	filter->uMaxQueuedFrames = 4;
+	filter->pDecodeQueue = NULL;
+	filter->pDecodePool = NULL;
+	filter->uFlushSeq = 0;
+	g_mutex_init(&filter->decodeLock);
+	filter->uDecodeInterval = 1;
+	filter->dMaxDecodeFps = 0;
+	filter->bAdaptiveDecode = FALSE;
+	filter->uAdaptiveMaxInterval = 8;
+	filter->uAdaptiveIdleFrames = 10;
+	gst_barcode_reader_reset_cadence(filter);
+	filter->bAttachMeta = FALSE;
+	filter->bAttachRoiMeta = FALSE;
+	filter->pMetaBarcodes = g_array_new(FALSE, FALSE, sizeof(GstBarcodeMetaEntry));
+	g_array_set_clear_func(filter->pMetaBarcodes, gst_barcode_meta_entry_clear);
+	filter->metaPts = GST_CLOCK_TIME_NONE;
+	filter->bMetaPending = FALSE;
+	filter->bEmitSignals = TRUE;
+	filter->bPostMessages = FALSE;
+	filter->uMessageBatchFrames = 0;
+	filter->messageBatchTime = 0;
+	filter->pMessageBarcodes = g_ptr_array_new_with_free_func((GDestroyNotify)gst_structure_free);
+	filter->pRegions = g_array_new(FALSE, FALSE, sizeof(GstBarcodeReaderRegion));
+	filter->pFrameRegions = g_array_new(FALSE, FALSE, sizeof(GstBarcodeReaderRegion));
+	filter->bUseRoiMeta = FALSE;
+	filter->bParallelRoi = FALSE;
+	filter->pMotionGate = motion_gate_new();
+	filter->uMotionThreshold = 0;
+	filter->bMotionRestrict = FALSE;
+	filter->pTracker = barcode_tracker_new();
+	filter->bTracking = FALSE;
+	filter->uFullScanInterval = 10;
+	filter->uPyramidFactor = 1;
+	filter->uMaxCandidates = 8;
+	filter->uPyramidFullScanInterval = 10;
+	filter->uFramesSincePyramidScan = 0;
+	filter->bAdaptiveEffort = FALSE;
+	filter->effortBudget = 0;
+	filter->maxDecodeLatency = 0;
+	filter->dDecodeCost = -1;
+	gst_barcode_reader_reset_qos(filter);
+	filter->uFramesSinceFullScan = 0;
+	filter->bFullScanPending = FALSE;
+	filter->messageBatchStart = GST_CLOCK_TIME_NONE;
+	filter->uMessageBatchedFrames = 0;
+	gst_barcode_reader_workspace_init(&filter->streamWork);
+	gst_barcode_reader_workspace_init(&filter->jobWork);
+	filter->pSpareJobs = NULL;
+	filter->uSpareJobs = 0;
+	g_mutex_init(&filter->jobPoolLock);
+	filter->pOverlay = overlay_new();
+	filter->uOverlayThickness = 1;
+	filter->uOverlayFillAlpha = 0;
 }
@@ -4,7 +4,14 @@
 #include <gst/video/video.h>
 #include <gst/video/gstvideofilter.h>
 #include <ZXing/ZXingC.h>
-#include <time.h>
+
+#include "barcode-cache.h"
+#include "barcode-result.h"
+#include "decode-queue.h"
+#include "luma.h"
+#include "motion.h"
+#include "tracker.h"
+#include "utils.h"
 
 
 G_BEGIN_DECLS
@@ -21,6 +28,45 @@ G_BEGIN_DECLS
 typedef struct _GstBarcodeReader GstBarcodeReader;
 typedef struct _GstBarcodeReaderClass GstBarcodeReaderClass;
 
+typedef enum
+{
+	GST_BARCODE_READER_PRESET_CUSTOM,
+	GST_BARCODE_READER_PRESET_FAST,
+	GST_BARCODE_READER_PRESET_BALANCED,
+	GST_BARCODE_READER_PRESET_THOROUGH,
+} GstBarcodeReaderPreset;
+
+typedef struct
+{
+	gint x;
+	gint y;
+	gint width;
+	gint height;
+} GstBarcodeReaderRegion;
+
+// immutable snapshot of the ZXing settings, decodes keep a reference to the one they started with
+typedef struct
+{
+	gint refCount;
+	ZXing_ReaderOptions* pOpts;
+	ZXing_ReaderOptions* pDetectOpts;	// pyramid pass, locates codes without decoding them
+	ZXing_ReaderOptions* pCheapOpts;	// first pass of adaptive effort
+} GstBarcodeReaderConfig;
+
+// buffers of one decoding thread, reused from frame to frame
+typedef struct
+{
+	LumaPlane luma;
+	GPtrArray* pResults;	// GstBarcodeResult of the last decode
+	GArray* pCandidates;	// GstBarcodeReaderRegion found by the pyramid pass
+	GPtrArray* pBarcodes;	// ZXing_Barcodes* per decoded region
+	guint8* pScratch;		// downscaled region of the pyramid pass
+	gsize scratchSize;
+	GArray* pReport;		// GstStructure* for barcode-signal, emitted after unlocking
+	gboolean bEmitReport;
+	DecodeBatch* pBatch;	// parallel region decodes, created on first use
+} GstBarcodeReaderWorkspace;
+
 /**
  * GstBarcodeReader:
  *
@@ -35,17 +81,92 @@ struct _GstBarcodeReader
 	GstVideoFormat format;
 	gint width;
 	gint height;
+	GstClockTime frameDuration;	// 0 for variable frame rates
 
 	guint uBarcodeFormats;
 	gboolean bEnableReader;
 	gboolean bShowLocation;
 	guint uCoiStartX;
 	guint uCoiWidth;
+	Overlay* pOverlay;
+	guint uOverlayThickness;
+	guint uOverlayFillAlpha;
+	GArray* pRegions;
+	GArray* pFrameRegions;
+	gboolean bUseRoiMeta;
+	gboolean bParallelRoi;
+	MotionGate* pMotionGate;
+	guint uMotionThreshold;
+	gboolean bMotionRestrict;
+	BarcodeTracker* pTracker;
+	gboolean bTracking;
+	guint uFullScanInterval;
+	guint uFramesSinceFullScan;
+	gboolean bFullScanPending;
+	guint uPyramidFactor;
+	guint uMaxCandidates;
+	guint uPyramidFullScanInterval;
+	guint uFramesSincePyramidScan;
+	gboolean bAdaptiveEffort;
+	GstClockTime effortBudget;
+	GstClockTime maxDecodeLatency;
+	gdouble dDecodeCost;		// moving average in nanoseconds, negative until measured
+	gdouble dQosProportion;
+	GstClockTime qosEarliestTime;
 	ZXing_ImageFormat eImageFormat;
-	ZXing_ReaderOptions* pOpts;
-	GArray* pBarcodes;
+	GstBarcodeReaderWorkspace streamWork;	// owned by the streaming thread
+	GstBarcodeReaderWorkspace jobWork;		// used by queued decodes, luma under decodeLock
+	GstBarcodeReaderConfig* pConfig;
+	GMutex configLock;			// guards only the pConfig pointer
+	GstBarcodeReaderPreset ePreset;
+	gboolean bTryHarder;
+	gboolean bTryRotate;
+	gboolean bTryInvert;
+	gboolean bTryDownscale;
+	ZXing_Binarizer eBinarizer;
+	gboolean bIsPure;
+	gint iMinLineCount;
+	gint iMaxNumberOfSymbols;
+	BarcodeCache* pBarcodeCache;
+	GstClockTime dedupTtl;
+	guint uDedupCapacity;
+	GArray* pPositions;
+
+	gboolean bAsyncDecode;
+	DecodeQueuePolicy eQueuePolicy;
+	guint uMaxQueuedFrames;
+	DecodeQueue* pDecodeQueue;
+	DecodePool* pDecodePool;	// held from the first parallel decode until stop
+	GMutex decodeLock;
+	struct _GstBarcodeReaderJob* pSpareJobs;
+	guint uSpareJobs;
+	guint uFlushSeq;			// bumped on flush, results of older jobs are dropped
+	GMutex jobPoolLock;
+
+	guint uDecodeInterval;
+	gdouble dMaxDecodeFps;
+	gboolean bAdaptiveDecode;
+	guint uAdaptiveMaxInterval;
+	guint uAdaptiveIdleFrames;
+	guint uAdaptiveInterval;
+	guint uEmptyDecodes;
+	guint uFramesSinceDecode;
+	GstClockTime lastDecodeTime;
+
+	gboolean bAttachMeta;
+	gboolean bAttachRoiMeta;
+	GArray* pMetaBarcodes;
+	GstClockTime metaPts;
+	gboolean bMetaPending;
+
+	gboolean bEmitSignals;
+	gboolean bPostMessages;
+	guint uMessageBatchFrames;
+	GstClockTime messageBatchTime;
+	GPtrArray* pMessageBarcodes;
+	GstClockTime messageBatchStart;
+	guint uMessageBatchedFrames;
 
-	time_t prevBarcodeTime;
 };
 
 struct _GstBarcodeReaderClass
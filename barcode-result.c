@@ -0,0 +1,132 @@
+#include "barcode-result.h"
+
+
+GST_DEFINE_MINI_OBJECT_TYPE(GstBarcodeResult, gst_barcode_result);
+
+static void gst_barcode_result_free(GstMiniObject* obj)
+{
+	GstBarcodeResult* result = (GstBarcodeResult*)obj;
+
+	ZXing_free(result->text);
+	ZXing_free(result->ecLevel);
+	ZXing_free(result->symbologyIdentifier);
+
+	if (result->bytes)
+		g_bytes_unref(result->bytes);
+
+	ZXing_Barcode_delete(result->barcode);
+	g_free(result);
+}
+
+GstBarcodeResult* gst_barcode_result_new(ZXing_Barcode* barcode, const ZXing_Position* position)
+{
+	GstBarcodeResult* result = g_new0(GstBarcodeResult, 1);
+
+	// no copy function, results never change once decoded
+	gst_mini_object_init(GST_MINI_OBJECT_CAST(result), 0, GST_TYPE_BARCODE_RESULT, NULL, NULL, gst_barcode_result_free);
+
+	result->barcode = barcode;
+	result->position = *position;
+	result->format = ZXing_Barcode_format(barcode);
+
+	return result;
+}
+
+// stores value in an empty slot, a reader that raced us keeps the first value
+static gpointer gst_barcode_result_publish(gpointer* slot, gpointer value, GDestroyNotify destroy)
+{
+	if (g_atomic_pointer_compare_and_exchange(slot, NULL, value))
+		return value;
+
+	destroy(value);
+
+	return g_atomic_pointer_get(slot);
+}
+
+const gchar* gst_barcode_result_get_text(GstBarcodeResult* result)
+{
+	gpointer text = g_atomic_pointer_get(&result->text);
+
+	if (!text)
+		text = gst_barcode_result_publish(&result->text, ZXing_Barcode_text(result->barcode), ZXing_free);
+
+	return text;
+}
+
+GBytes* gst_barcode_result_get_bytes(GstBarcodeResult* result)
+{
+	gpointer bytes = g_atomic_pointer_get(&result->bytes);
+
+	if (!bytes)
+	{
+		int len = 0;
+		uint8_t* pData = ZXing_Barcode_bytes(result->barcode, &len);
+
+		// hands ZXing's buffer over without copying it
+		bytes = gst_barcode_result_publish(&result->bytes,
+			g_bytes_new_with_free_func(pData, MAX(len, 0), ZXing_free, pData), (GDestroyNotify)g_bytes_unref);
+	}
+
+	return bytes;
+}
+
+const gchar* gst_barcode_result_get_ec_level(GstBarcodeResult* result)
+{
+	gpointer ecLevel = g_atomic_pointer_get(&result->ecLevel);
+
+	if (!ecLevel)
+		ecLevel = gst_barcode_result_publish(&result->ecLevel, ZXing_Barcode_ecLevel(result->barcode), ZXing_free);
+
+	return ecLevel;
+}
+
+const gchar* gst_barcode_result_get_symbology_identifier(GstBarcodeResult* result)
+{
+	gpointer symbologyIdentifier = g_atomic_pointer_get(&result->symbologyIdentifier);
+
+	if (!symbologyIdentifier)
+	{
+		symbologyIdentifier = gst_barcode_result_publish(&result->symbologyIdentifier,
+			ZXing_Barcode_symbologyIdentifier(result->barcode), ZXing_free);
+	}
+
+	return symbologyIdentifier;
+}
+
+const gchar* gst_barcode_result_get_format_name(const GstBarcodeResult* result)
+{
+	return gst_barcode_format_get_name(result->format);
+}
+
+// ZXing hands out a fresh string on every call, keep one interned copy per format
+const gchar* gst_barcode_format_get_name(ZXing_BarcodeFormat format)
+{
+	static const gchar* names[32] = { NULL };
+	gint bit = g_bit_nth_lsf((gulong)format, -1);
+	const gchar* pName = NULL;
+
+	// only single formats are cached, combinations are not reported by ZXing
+	if (bit < 0 || bit >= 32 || ((guint)format & ~(1u << bit)) != 0)
+		bit = -1;
+
+	if (bit >= 0)
+		pName = g_atomic_pointer_get(&names[bit]);
+
+	if (!pName)
+	{
+		char* pFormat = ZXing_BarcodeFormatToString(format);
+
+		pName = g_intern_string(pFormat);
+		ZXing_free(pFormat);
+
+		if (bit >= 0)
+			g_atomic_pointer_set(&names[bit], (gpointer)pName);
+	}
+
+	return pName;
+}
+
+gint gst_barcode_result_get_orientation(const GstBarcodeResult* result)
+{
+	return ZXing_Barcode_orientation(result->barcode);
+}
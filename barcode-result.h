@@ -0,0 +1,68 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <ZXing/ZXingC.h>
+
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_BARCODE_RESULT (gst_barcode_result_get_type())
+#define GST_IS_BARCODE_RESULT(obj) (GST_IS_MINI_OBJECT_TYPE(obj, GST_TYPE_BARCODE_RESULT))
+#define GST_BARCODE_RESULT_CAST(obj) ((GstBarcodeResult*)(obj))
+
+typedef struct _GstBarcodeResult GstBarcodeResult;
+
+/**
+ * GstBarcodeResult:
+ * @mini_object: parent #GstMiniObject
+ * @position: corners of the barcode in frame coordinates
+ * @format: symbology of the barcode
+ *
+ * One decoded barcode. Owns the ZXing barcode and converts text, bytes, error
+ * correction level and symbology identifier on first access only, the
+ * returned values stay valid as long as the result. Results are immutable and
+ * safe to read from any thread, pass them around by reference.
+ */
+struct _GstBarcodeResult
+{
+	GstMiniObject mini_object;
+
+	ZXing_Position position;
+	ZXing_BarcodeFormat format;
+
+	/*< private >*/
+	ZXing_Barcode* barcode;
+	gpointer text;
+	gpointer bytes;
+	gpointer ecLevel;
+	gpointer symbologyIdentifier;
+};
+
+GType gst_barcode_result_get_type(void);
+
+// takes ownership of barcode, as handed out by ZXing_Barcodes_move
+GstBarcodeResult* gst_barcode_result_new(ZXing_Barcode* barcode, const ZXing_Position* position);
+
+static inline GstBarcodeResult* gst_barcode_result_ref(GstBarcodeResult* result)
+{
+	return (GstBarcodeResult*)gst_mini_object_ref(GST_MINI_OBJECT_CAST(result));
+}
+
+static inline void gst_barcode_result_unref(GstBarcodeResult* result)
+{
+	gst_mini_object_unref(GST_MINI_OBJECT_CAST(result));
+}
+
+const gchar* gst_barcode_result_get_text(GstBarcodeResult* result);
+GBytes* gst_barcode_result_get_bytes(GstBarcodeResult* result);
+const gchar* gst_barcode_result_get_ec_level(GstBarcodeResult* result);
+const gchar* gst_barcode_result_get_symbology_identifier(GstBarcodeResult* result);
+
+// interned, cached per format
+const gchar* gst_barcode_result_get_format_name(const GstBarcodeResult* result);
+const gchar* gst_barcode_format_get_name(ZXing_BarcodeFormat format);
+
+// in degrees
+gint gst_barcode_result_get_orientation(const GstBarcodeResult* result);
+
+G_END_DECLS
@@ -0,0 +1,911 @@
+// Pushes a reproducible corpus of raw frames through barcodereader and prints
+// throughput, per-frame latency, CPU time and allocations per frame as JSON.
+//
+//   barcode-bench --sizes 1280x720 --formats NV12,BGRx --set try-harder=false
+//
+// Frames are generated from --seed before anything is measured and pushed by
+// reference, latency is taken between pad probes on the element's sink and src
+// pads. With async-decode=true it only covers the streaming thread.
+//
+// Allocations are counted through the C library on glibc and through the debug
+// CRT in Debug builds with MSVC, "alloc_counter" in the report tells which.
+// Without either allocs_per_frame is null.
+//
+// --max-allocs N turns the run into a check: the exit code is 2 when frames
+// without codes allocate more than N times per frame after the warmup. ZXing
+// allocates inside every read, so 0 only holds for frames the element doesn't
+// hand to ZXing, e.g. --scenes empty --set decode-interval=1000 --max-allocs 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/video/video.h>
+
+#ifdef G_OS_WIN32
+#include <windows.h>
+#ifdef _DEBUG
+#include <crtdbg.h>
+#endif
+#else
+#include <sys/resource.h>
+#endif
+
+
+#define BENCH_VARIANTS 4		// jittered copies of every scene, pushed round robin
+#define BENCH_BACKGROUND 0xE0
+#define BENCH_INK 0x20
+
+static gint bench_counting = 0;
+static gint bench_allocs = 0;
+
+#ifdef __GLIBC__
+// counts every allocation of the process while a measured window is open
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+
+#define BENCH_COUNT_ALLOC() \
+	do { if (g_atomic_int_get(&bench_counting)) g_atomic_int_inc(&bench_allocs); } while (0)
+
+void* malloc(size_t size)
+{
+	BENCH_COUNT_ALLOC();
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+	BENCH_COUNT_ALLOC();
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+	BENCH_COUNT_ALLOC();
+	return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+	BENCH_COUNT_ALLOC();
+	return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+	BENCH_COUNT_ALLOC();
+	return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+	BENCH_COUNT_ALLOC();
+	*ptr = __libc_memalign(alignment, size);
+	return *ptr ? 0 : 12;	// ENOMEM
+}
+
+#define BENCH_HAVE_ALLOC_COUNT 1
+#define BENCH_ALLOC_COUNTER "libc"
+#elif defined(_MSC_VER) && defined(_DEBUG)
+// the debug CRT reports the allocations of every module linked against it,
+// that is the bench, the plugin and ZXing when built as Debug. Release builds
+// of GLib and GStreamer bring their own CRT and are not seen
+static int __cdecl bench_alloc_hook(int allocType, void* pData, size_t size, int blockType, long request,
+	const unsigned char* pFile, int line)
+{
+	if (blockType != _CRT_BLOCK && (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC)
+		&& g_atomic_int_get(&bench_counting))
+	{
+		g_atomic_int_inc(&bench_allocs);
+	}
+
+	return TRUE;
+}
+
+#define BENCH_HAVE_ALLOC_COUNT 1
+#define BENCH_ALLOC_COUNTER "crt-debug"
+#else
+#define BENCH_HAVE_ALLOC_COUNT 0
+#define BENCH_ALLOC_COUNTER NULL
+#endif
+
+typedef struct
+{
+	guint8* pData;
+	gint width;
+	gint height;
+	gint stride;
+} BenchCanvas;
+
+typedef enum
+{
+	BENCH_SCENE_EMPTY,
+	BENCH_SCENE_EAN13,
+	BENCH_SCENE_ITF,
+	BENCH_SCENE_MANY,
+	BENCH_NUM_SCENES,
+} BenchScene;
+
+static const gchar* bench_scene_names[BENCH_NUM_SCENES] = { "empty", "ean13", "itf", "many" };
+
+typedef struct
+{
+	GstVideoInfo info;
+	BenchScene eScene;
+	guint uCodes[BENCH_VARIANTS];		// variants are jittered, their code counts may differ
+	GstBuffer* pFrames[BENCH_VARIANTS];
+} BenchCorpus;
+
+// filled by the pad probes, indexed by the buffer offset
+typedef struct
+{
+	guint uFrames;
+	guint uWarmup;
+	gint64* pIn;
+	gint64* pOut;
+	gint64 cpuStart;
+	gint64 cpuEnd;
+	gint allocStart;
+	gint allocEnd;
+} BenchTimes;
+
+typedef struct
+{
+	gchar* pSizes;
+	gchar* pFormats;
+	gchar* pScenes;
+	gchar** ppSettings;
+	gchar* pOutput;
+	gint iFrames;
+	gint iWarmup;
+	gint iSeed;
+	gint iMaxAllocs;	// per frame without codes, negative when not checked
+} BenchOptions;
+
+static gint64 bench_cpu_time(void)
+{
+#ifdef G_OS_WIN32
+	FILETIME creation, exitTime, kernel, user;
+
+	GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user);
+
+	return (gint64)(((((guint64)kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime)
+		+ ((((guint64)user.dwHighDateTime) << 32) | user.dwLowDateTime)) / 10;
+#else
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+
+	return (gint64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC
+		+ usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+static void bench_fill_rect(BenchCanvas* canvas, gint x, gint y, gint width, gint height, guint8 value)
+{
+	gint x0 = CLAMP(x, 0, canvas->width);
+	gint y0 = CLAMP(y, 0, canvas->height);
+	gint x1 = CLAMP(x + width, 0, canvas->width);
+	gint y1 = CLAMP(y + height, 0, canvas->height);
+
+	for (gint row = y0; row < y1; row++)
+		memset(canvas->pData + (gsize)row * canvas->stride + x0, value, x1 - x0);
+}
+
+// draws a string of '1' (bar) and '0' (space) modules, returns the end x
+static gint bench_draw_modules(BenchCanvas* canvas, gint x, gint y, gint module, gint height, const gchar* pModules)
+{
+	for (; *pModules; pModules++, x += module)
+	{
+		if (*pModules == '1')
+			bench_fill_rect(canvas, x, y, module, height, BENCH_INK);
+	}
+
+	return x;
+}
+
+// GS1 check digit over the digits in front of it, weights 3 and 1 from the right
+static gchar bench_check_digit(const gchar* pDigits, gint len)
+{
+	gint sum = 0;
+
+	for (gint i = 0; i < len; i++)
+		sum += (pDigits[len - 1 - i] - '0') * (i % 2 ? 1 : 3);
+
+	return (gchar)('0' + (10 - sum % 10) % 10);
+}
+
+static gint bench_ean13_width(gint module)
+{
+	return (95 + 2 * 9) * module;
+}
+
+// pDigits holds 12 digits, the check digit is appended
+static void bench_draw_ean13(BenchCanvas* canvas, gint x, gint y, gint module, gint height, const gchar* pDigits)
+{
+	static const gchar* codesL[10] = { "0001101", "0011001", "0010011", "0111101", "0100011", "0110001", "0101111", "0111011", "0110111", "0001011" };
+	static const gchar* codesG[10] = { "0100111", "0110011", "0011011", "0100001", "0011101", "0111001", "0000101", "0010001", "0001001", "0010111" };
+	static const gchar* codesR[10] = { "1110010", "1100110", "1101100", "1000010", "1011100", "1001110", "1010000", "1000100", "1001000", "1110100" };
+	static const gchar* parities[10] = { "LLLLLL", "LLGLGG", "LLGGLG", "LLGGGL", "LGLLGG", "LGGLLG", "LGGGLL", "LGLGLG", "LGLGGL", "LGGLGL" };
+	gchar digits[14];
+	GString* pModules = g_string_new("101");
+
+	memcpy(digits, pDigits, 12);
+	digits[12] = bench_check_digit(digits, 12);
+	digits[13] = 0;
+
+	for (gint i = 1; i <= 6; i++)
+	{
+		gint d = digits[i] - '0';
+		g_string_append(pModules, parities[digits[0] - '0'][i - 1] == 'L' ? codesL[d] : codesG[d]);
+	}
+
+	g_string_append(pModules, "01010");
+
+	for (gint i = 7; i <= 12; i++)
+		g_string_append(pModules, codesR[digits[i] - '0']);
+
+	g_string_append(pModules, "101");
+
+	bench_draw_modules(canvas, x + 9 * module, y, module, height, pModules->str);
+	g_string_free(pModules, TRUE);
+}
+
+static gint bench_itf_width(gint module)
+{
+	// start, 7 digit pairs of 18 modules, stop and the quiet zones
+	return (4 + 7 * 18 + 5 + 2 * 10) * module;
+}
+
+// ITF-14, pDigits holds 13 digits, the check digit is appended
+static void bench_draw_itf(BenchCanvas* canvas, gint x, gint y, gint module, gint height, const gchar* pDigits)
+{
+	static const gchar* patterns[10] = { "nnwwn", "wnnnw", "nwnnw", "wwnnn", "nnwnw", "wnwnn", "nwwnn", "nnnww", "wnnwn", "nwnwn" };
+	gchar digits[15];
+	GString* pModules = g_string_new("1010");
+
+	memcpy(digits, pDigits, 13);
+	digits[13] = bench_check_digit(digits, 13);
+	digits[14] = 0;
+
+	// the first digit of a pair sets the bars, the second the spaces
+	for (gint i = 0; i < 14; i += 2)
+	{
+		const gchar* pBars = patterns[digits[i] - '0'];
+		const gchar* pSpaces = patterns[digits[i + 1] - '0'];
+
+		for (gint j = 0; j < 5; j++)
+		{
+			g_string_append(pModules, pBars[j] == 'w' ? "111" : "1");
+			g_string_append(pModules, pSpaces[j] == 'w' ? "000" : "0");
+		}
+	}
+
+	g_string_append(pModules, "11101");
+
+	bench_draw_modules(canvas, x + 10 * module, y, module, height, pModules->str);
+	g_string_free(pModules, TRUE);
+}
+
+static void bench_random_digits(GRand* rand, gchar* pDigits, gint len)
+{
+	for (gint i = 0; i < len; i++)
+		pDigits[i] = (gchar)('0' + g_rand_int_range(rand, 0, 10));
+}
+
+// draws a code of the scene's symbology, or alternating ones for the busy scene,
+// returns FALSE when it does not fit
+static gboolean bench_draw_code(BenchCanvas* canvas, GRand* rand, gboolean bEan, gint x, gint y, gint module, gint height)
+{
+	gchar digits[13];
+
+	if (x + (bEan ? bench_ean13_width(module) : bench_itf_width(module)) > canvas->width || y + height > canvas->height)
+		return FALSE;
+
+	bench_random_digits(rand, digits, sizeof(digits));
+
+	if (bEan)
+		bench_draw_ean13(canvas, x, y, module, height, digits);
+	else
+		bench_draw_itf(canvas, x, y, module, height, digits);
+
+	return TRUE;
+}
+
+static guint bench_draw_scene(BenchCanvas* canvas, GRand* rand, BenchScene eScene)
+{
+	gint module = MAX(2, canvas->width / 480);
+	gint barHeight = MAX(24, canvas->height / 10);
+	gint maxWidth = MAX(bench_ean13_width(module), bench_itf_width(module));
+	guint uCodes = 0;
+
+	// sensor noise keeps the empty scene from being trivially uniform
+	for (gint y = 0; y < canvas->height; y++)
+	{
+		guint8* pRow = canvas->pData + (gsize)y * canvas->stride;
+
+		for (gint x = 0; x < canvas->width; x++)
+			pRow[x] = (guint8)(BENCH_BACKGROUND + g_rand_int_range(rand, -12, 13));
+	}
+
+	if (eScene == BENCH_SCENE_EAN13 || eScene == BENCH_SCENE_ITF)
+	{
+		gint x = g_rand_int_range(rand, 0, MAX(1, canvas->width - maxWidth));
+		gint y = g_rand_int_range(rand, 0, MAX(1, canvas->height - barHeight));
+
+		uCodes += bench_draw_code(canvas, rand, eScene == BENCH_SCENE_EAN13, x, y, module, barHeight);
+	}
+	else if (eScene == BENCH_SCENE_MANY)
+	{
+		gint rows = MIN(6, canvas->height / (barHeight * 3 / 2));
+
+		for (gint row = 0; row < rows; row++)
+		{
+			gint x = g_rand_int_range(rand, 0, MAX(1, canvas->width - maxWidth));
+			gint y = row * (barHeight * 3 / 2) + barHeight / 4;
+
+			uCodes += bench_draw_code(canvas, rand, row % 2 == 0, x, y, module, barHeight);
+		}
+	}
+
+	return uCodes;
+}
+
+static GstBuffer* bench_convert_frame(GstBuffer* pGray, const GstVideoInfo* grayInfo, const GstVideoInfo* info)
+{
+	GstBuffer* pBuffer = gst_buffer_new_allocate(NULL, GST_VIDEO_INFO_SIZE(info), NULL);
+	GstVideoConverter* converter = gst_video_converter_new((GstVideoInfo*)grayInfo, (GstVideoInfo*)info, NULL);
+	GstVideoFrame src, dst;
+
+	gst_video_frame_map(&src, (GstVideoInfo*)grayInfo, pGray, GST_MAP_READ);
+	gst_video_frame_map(&dst, (GstVideoInfo*)info, pBuffer, GST_MAP_WRITE);
+	gst_video_converter_frame(converter, &src, &dst);
+	gst_video_frame_unmap(&dst);
+	gst_video_frame_unmap(&src);
+	gst_video_converter_free(converter);
+
+	return pBuffer;
+}
+
+static gboolean bench_corpus_init(BenchCorpus* corpus, gint width, gint height, GstVideoFormat eFormat, BenchScene eScene, guint uSeed)
+{
+	GstVideoInfo grayInfo;
+	GRand* rand = g_rand_new_with_seed(uSeed);
+
+	memset(corpus, 0, sizeof(*corpus));
+	corpus->eScene = eScene;
+
+	gst_video_info_set_format(&grayInfo, GST_VIDEO_FORMAT_GRAY8, width, height);
+
+	if (!gst_video_info_set_format(&corpus->info, eFormat, width, height))
+	{
+		g_rand_free(rand);
+		return FALSE;
+	}
+
+	for (guint i = 0; i < BENCH_VARIANTS; i++)
+	{
+		GstBuffer* pGray = gst_buffer_new_allocate(NULL, GST_VIDEO_INFO_SIZE(&grayInfo), NULL);
+		GstMapInfo map;
+		BenchCanvas canvas;
+
+		gst_buffer_map(pGray, &map, GST_MAP_WRITE);
+		canvas.pData = map.data;
+		canvas.width = width;
+		canvas.height = height;
+		canvas.stride = GST_VIDEO_INFO_PLANE_STRIDE(&grayInfo, 0);
+		corpus->uCodes[i] = bench_draw_scene(&canvas, rand, eScene);
+		gst_buffer_unmap(pGray, &map);
+
+		corpus->pFrames[i] = bench_convert_frame(pGray, &grayInfo, &corpus->info);
+		gst_buffer_unref(pGray);
+	}
+
+	g_rand_free(rand);
+
+	return TRUE;
+}
+
+static void bench_corpus_clear(BenchCorpus* corpus)
+{
+	for (guint i = 0; i < BENCH_VARIANTS; i++)
+	{
+		if (corpus->pFrames[i])
+			gst_buffer_unref(corpus->pFrames[i]);
+	}
+}
+
+static GstPadProbeReturn bench_sink_probe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+	BenchTimes* times = (BenchTimes*)user_data;
+	guint64 index = GST_BUFFER_OFFSET(GST_PAD_PROBE_INFO_BUFFER(info));
+
+	if (index >= times->uFrames)
+		return GST_PAD_PROBE_OK;
+
+	if (index == times->uWarmup)
+	{
+		times->cpuStart = bench_cpu_time();
+		times->allocStart = g_atomic_int_get(&bench_allocs);
+		g_atomic_int_set(&bench_counting, 1);
+	}
+
+	times->pIn[index] = g_get_monotonic_time();
+
+	return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn bench_src_probe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+	BenchTimes* times = (BenchTimes*)user_data;
+	guint64 index = GST_BUFFER_OFFSET(GST_PAD_PROBE_INFO_BUFFER(info));
+
+	if (index >= times->uFrames)
+		return GST_PAD_PROBE_OK;
+
+	times->pOut[index] = g_get_monotonic_time();
+
+	if (index == times->uFrames - 1)
+	{
+		g_atomic_int_set(&bench_counting, 0);
+		times->allocEnd = g_atomic_int_get(&bench_allocs);
+		times->cpuEnd = bench_cpu_time();
+	}
+
+	return GST_PAD_PROBE_OK;
+}
+
+static gint bench_compare_gint64(gconstpointer a, gconstpointer b)
+{
+	gint64 x = *(const gint64*)a;
+	gint64 y = *(const gint64*)b;
+
+	return x < y ? -1 : x > y;
+}
+
+// nearest rank percentile of sorted samples
+static gint64 bench_percentile(const gint64* pSorted, guint count, gdouble p)
+{
+	guint rank = (guint)(p * count + 0.999999);
+
+	return pSorted[CLAMP(rank, 1, count) - 1];
+}
+
+static gboolean bench_apply_settings(GstElement* reader, gchar** ppSettings, GError** error)
+{
+	for (gchar** pp = ppSettings; pp && *pp; pp++)
+	{
+		gchar** kv = g_strsplit(*pp, "=", 2);
+
+		if (!kv[0] || !kv[1] || !g_object_class_find_property(G_OBJECT_GET_CLASS(reader), kv[0]))
+		{
+			g_set_error(error, GST_CORE_ERROR, GST_CORE_ERROR_FAILED, "invalid setting '%s'", *pp);
+			g_strfreev(kv);
+			return FALSE;
+		}
+
+		gst_util_set_object_arg(G_OBJECT(reader), kv[0], kv[1]);
+		g_strfreev(kv);
+	}
+
+	return TRUE;
+}
+
+// runs one corpus through a fresh pipeline and appends its JSON object to pJson
+// pbOverBudget is set when the case allocated more than --max-allocs allows
+static gboolean bench_run_case(const BenchOptions* options, const BenchCorpus* corpus, GString* pJson,
+	gboolean* pbOverBudget, GError** error)
+{
+	BenchTimes times = { 0 };
+	GstElement* pipeline = gst_pipeline_new(NULL);
+	GstElement* src = gst_element_factory_make("appsrc", NULL);
+	GstElement* reader = gst_element_factory_make("barcodereader", NULL);
+	GstElement* sink = gst_element_factory_make("fakesink", NULL);
+	GstCaps* caps = gst_video_info_to_caps((GstVideoInfo*)&corpus->info);
+	GstBuffer** ppBuffers;
+	GstPad* pad;
+	GstMessage* msg;
+	gboolean bOk = FALSE;
+
+	if (!reader)
+	{
+		g_set_error(error, GST_CORE_ERROR, GST_CORE_ERROR_MISSING_PLUGIN, "barcodereader not found, check GST_PLUGIN_PATH");
+		goto done;
+	}
+
+	if (!bench_apply_settings(reader, options->ppSettings, error))
+		goto done;
+
+	g_object_set(src, "caps", caps, "format", GST_FORMAT_TIME, "block", TRUE,
+		"max-bytes", (guint64)GST_VIDEO_INFO_SIZE(&corpus->info) * 4, NULL);
+	g_object_set(sink, "sync", FALSE, NULL);
+
+	gst_bin_add_many(GST_BIN(pipeline), src, reader, sink, NULL);
+	gst_element_link_many(src, reader, sink, NULL);
+
+	times.uFrames = (guint)options->iFrames;
+	times.uWarmup = (guint)options->iWarmup;
+	times.pIn = g_new0(gint64, times.uFrames);
+	times.pOut = g_new0(gint64, times.uFrames);
+
+	pad = gst_element_get_static_pad(reader, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, bench_sink_probe, &times, NULL);
+	gst_object_unref(pad);
+	pad = gst_element_get_static_pad(reader, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, bench_src_probe, &times, NULL);
+	gst_object_unref(pad);
+
+	// shallow copies share the corpus memory, made up front so the measured
+	// window sees no allocations of ours
+	ppBuffers = g_new(GstBuffer*, times.uFrames);
+
+	for (guint i = 0; i < times.uFrames; i++)
+	{
+		ppBuffers[i] = gst_buffer_copy(corpus->pFrames[i % BENCH_VARIANTS]);
+		GST_BUFFER_PTS(ppBuffers[i]) = gst_util_uint64_scale(i, GST_SECOND, 30);
+		GST_BUFFER_DURATION(ppBuffers[i]) = GST_SECOND / 30;
+		GST_BUFFER_OFFSET(ppBuffers[i]) = i;
+	}
+
+	gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+	for (guint i = 0; i < times.uFrames; i++)
+		gst_app_src_push_buffer(GST_APP_SRC(src), ppBuffers[i]);
+
+	g_free(ppBuffers);
+	gst_app_src_end_of_stream(GST_APP_SRC(src));
+
+	msg = gst_bus_timed_pop_filtered(GST_ELEMENT_BUS(pipeline), GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+
+	if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
+	{
+		gst_message_parse_error(msg, error, NULL);
+	}
+	else
+	{
+		guint count = times.uFrames - times.uWarmup;
+		gint64* pLatency = g_new(gint64, count);
+		gint64 sum = 0;
+		gdouble elapsed = (gdouble)(times.pOut[times.uFrames - 1] - times.pIn[times.uWarmup]) / G_USEC_PER_SEC;
+
+		for (guint i = 0; i < count; i++)
+		{
+			pLatency[i] = times.pOut[times.uWarmup + i] - times.pIn[times.uWarmup + i];
+			sum += pLatency[i];
+		}
+
+		qsort(pLatency, count, sizeof(gint64), bench_compare_gint64);
+
+		g_string_append_printf(pJson, "    {\"width\": %d, \"height\": %d, \"format\": \"%s\", \"scene\": \"%s\", \"codes\": [",
+			GST_VIDEO_INFO_WIDTH(&corpus->info), GST_VIDEO_INFO_HEIGHT(&corpus->info),
+			gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&corpus->info)), bench_scene_names[corpus->eScene]);
+
+		for (guint i = 0; i < BENCH_VARIANTS; i++)
+			g_string_append_printf(pJson, i ? ", %u" : "%u", corpus->uCodes[i]);
+
+		g_string_append_printf(pJson,
+			"], \"frames\": %u, \"fps\": %.2f, \"latency_us\": {\"p50\": %" G_GINT64_FORMAT ", \"p95\": %" G_GINT64_FORMAT
+			", \"p99\": %" G_GINT64_FORMAT ", \"max\": %" G_GINT64_FORMAT ", \"mean\": %.1f}, \"cpu_us_per_frame\": %.1f, ",
+			count, elapsed > 0 ? count / elapsed : 0.0,
+			bench_percentile(pLatency, count, 0.50), bench_percentile(pLatency, count, 0.95),
+			bench_percentile(pLatency, count, 0.99), pLatency[count - 1], (gdouble)sum / count,
+			(gdouble)(times.cpuEnd - times.cpuStart) / count);
+
+		if (BENCH_HAVE_ALLOC_COUNT)
+			g_string_append_printf(pJson, "\"allocs_per_frame\": %.2f}", (gdouble)(times.allocEnd - times.allocStart) / count);
+		else
+			g_string_append(pJson, "\"allocs_per_frame\": null}");
+
+		guint uCodes = 0;
+
+		for (guint i = 0; i < BENCH_VARIANTS; i++)
+			uCodes += corpus->uCodes[i];
+
+		// frames with codes allocate their results, only the others are checked
+		if (BENCH_HAVE_ALLOC_COUNT && options->iMaxAllocs >= 0 && uCodes == 0
+			&& (gint64)(times.allocEnd - times.allocStart) > (gint64)options->iMaxAllocs * count)
+		{
+			g_printerr("%dx%d %s %s: %.2f allocations per frame, at most %d allowed\n",
+				GST_VIDEO_INFO_WIDTH(&corpus->info), GST_VIDEO_INFO_HEIGHT(&corpus->info),
+				gst_video_format_to_string(GST_VIDEO_INFO_FORMAT(&corpus->info)), bench_scene_names[corpus->eScene],
+				(gdouble)(times.allocEnd - times.allocStart) / count, options->iMaxAllocs);
+			*pbOverBudget = TRUE;
+		}
+
+		g_free(pLatency);
+		bOk = TRUE;
+	}
+
+	gst_message_unref(msg);
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	g_free(times.pIn);
+	g_free(times.pOut);
+
+done:
+	gst_caps_unref(caps);
+
+	// elements that were never added are still floating
+	if (reader && !GST_OBJECT_PARENT(reader))
+		gst_object_unref(gst_object_ref_sink(reader));
+
+	if (!GST_OBJECT_PARENT(src))
+	{
+		gst_object_unref(gst_object_ref_sink(src));
+		gst_object_unref(gst_object_ref_sink(sink));
+	}
+
+	gst_object_unref(pipeline);
+
+	return bOk;
+}
+
+// formats the element accepts, straight from its sink pad template
+static gboolean bench_supported_format(GstElementFactory* factory, const gchar* pFormat)
+{
+	GstCaps* caps = gst_caps_from_string("video/x-raw");
+	gboolean bSupported = FALSE;
+
+	gst_caps_set_simple(caps, "format", G_TYPE_STRING, pFormat, NULL);
+
+	for (const GList* l = gst_element_factory_get_static_pad_templates(factory); l; l = l->next)
+	{
+		GstStaticPadTemplate* templ = (GstStaticPadTemplate*)l->data;
+
+		if (templ->direction == GST_PAD_SINK)
+		{
+			GstCaps* templCaps = gst_static_caps_get(&templ->static_caps);
+			bSupported = gst_caps_can_intersect(caps, templCaps);
+			gst_caps_unref(templCaps);
+		}
+	}
+
+	gst_caps_unref(caps);
+
+	return bSupported;
+}
+
+static gchar** bench_all_formats(GstElementFactory* factory)
+{
+	GPtrArray* pFormats = g_ptr_array_new();
+
+	for (const GList* l = gst_element_factory_get_static_pad_templates(factory); l; l = l->next)
+	{
+		GstStaticPadTemplate* templ = (GstStaticPadTemplate*)l->data;
+		GstCaps* caps;
+		const GValue* list;
+
+		if (templ->direction != GST_PAD_SINK)
+			continue;
+
+		caps = gst_static_caps_get(&templ->static_caps);
+		list = gst_structure_get_value(gst_caps_get_structure(caps, 0), "format");
+
+		for (guint i = 0; list && GST_VALUE_HOLDS_LIST(list) && i < gst_value_list_get_size(list); i++)
+			g_ptr_array_add(pFormats, g_value_dup_string(gst_value_list_get_value(list, i)));
+
+		gst_caps_unref(caps);
+	}
+
+	g_ptr_array_add(pFormats, NULL);
+
+	return (gchar**)g_ptr_array_free(pFormats, FALSE);
+}
+
+static void bench_append_json_string(GString* pJson, const gchar* pText)
+{
+	g_string_append_c(pJson, '"');
+
+	for (; *pText; pText++)
+	{
+		if (*pText == '"' || *pText == '\\')
+			g_string_append_c(pJson, '\\');
+
+		g_string_append_c(pJson, *pText);
+	}
+
+	g_string_append_c(pJson, '"');
+}
+
+int main(int argc, char* argv[])
+{
+	BenchOptions options = { NULL };
+	GOptionContext* context;
+	GError* error = NULL;
+	GstElementFactory* factory;
+	gchar** ppSizes;
+	gchar** ppFormats;
+	gchar** ppScenes;
+	GString* pJson;
+	gboolean bFirst = TRUE;
+	gboolean bOverBudget = FALSE;
+	int ret = 0;
+
+	options.iFrames = 300;
+	options.iWarmup = 20;
+	options.iSeed = 1;
+	options.iMaxAllocs = -1;
+
+	GOptionEntry entries[] =
+	{
+		{ "sizes", 0, 0, G_OPTION_ARG_STRING, &options.pSizes, "Comma separated frame sizes (640x480,1280x720,1920x1080)", "WxH,..." },
+		{ "formats", 0, 0, G_OPTION_ARG_STRING, &options.pFormats, "Comma separated video formats or 'all' (GRAY8,NV12,I420,YUY2,BGRx,RGB)", "FMT,..." },
+		{ "scenes", 0, 0, G_OPTION_ARG_STRING, &options.pScenes, "Comma separated scenes (empty,ean13,itf,many)", "SCENE,..." },
+		{ "set", 's', 0, G_OPTION_ARG_STRING_ARRAY, &options.ppSettings, "Set a barcodereader property, may be repeated", "PROP=VALUE" },
+		{ "frames", 'n', 0, G_OPTION_ARG_INT, &options.iFrames, "Frames per case including warmup, at least 2 (300)", "N" },
+		{ "warmup", 'w', 0, G_OPTION_ARG_INT, &options.iWarmup, "Frames excluded from the statistics, fewer than --frames (20)", "N" },
+		{ "seed", 0, 0, G_OPTION_ARG_INT, &options.iSeed, "Non-negative seed of the generated corpus (1)", "N" },
+		{ "max-allocs", 0, 0, G_OPTION_ARG_INT, &options.iMaxAllocs, "Exit with 2 when frames without codes allocate more often per frame", "N" },
+		{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &options.pOutput, "Write the JSON report to a file instead of stdout", "FILE" },
+		{ NULL }
+	};
+
+	context = g_option_context_new("- barcodereader benchmark");
+	g_option_context_add_main_entries(context, entries, NULL);
+	g_option_context_add_group(context, gst_init_get_option_group());
+
+	if (!g_option_context_parse(context, &argc, &argv, &error))
+	{
+		g_printerr("%s\n", error->message);
+		return 1;
+	}
+
+	g_option_context_free(context);
+
+	if (options.iFrames < 2 || options.iWarmup < 0 || options.iWarmup >= options.iFrames || options.iSeed < 0)
+	{
+		g_printerr("need --frames >= 2, 0 <= --warmup < --frames and --seed >= 0\n");
+		return 1;
+	}
+
+	if (options.iMaxAllocs >= 0 && !BENCH_HAVE_ALLOC_COUNT)
+	{
+		g_printerr("--max-allocs needs allocation counting, which this build doesn't have\n");
+		return 1;
+	}
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+	_CrtSetAllocHook(bench_alloc_hook);
+#endif
+
+	factory = gst_element_factory_find("barcodereader");
+	if (!factory)
+	{
+		g_printerr("barcodereader not found, check GST_PLUGIN_PATH\n");
+		return 1;
+	}
+
+	ppSizes = g_strsplit(options.pSizes ? options.pSizes : "640x480,1280x720,1920x1080", ",", -1);
+	ppScenes = g_strsplit(options.pScenes ? options.pScenes : "empty,ean13,itf,many", ",", -1);
+
+	if (options.pFormats && g_str_equal(options.pFormats, "all"))
+		ppFormats = bench_all_formats(factory);
+	else
+		ppFormats = g_strsplit(options.pFormats ? options.pFormats : "GRAY8,NV12,I420,YUY2,BGRx,RGB", ",", -1);
+
+	pJson = g_string_new("{\n  \"element\": \"barcodereader\",\n");
+	g_string_append_printf(pJson, "  \"frames\": %d,\n  \"warmup\": %d,\n  \"seed\": %d,\n  \"alloc_counter\": ",
+		options.iFrames, options.iWarmup, options.iSeed);
+
+	if (BENCH_HAVE_ALLOC_COUNT)
+		bench_append_json_string(pJson, BENCH_ALLOC_COUNTER);
+	else
+		g_string_append(pJson, "null");
+
+	g_string_append(pJson, ",\n  \"settings\": {");
+
+	for (gchar** pp = options.ppSettings; pp && *pp; pp++)
+	{
+		gchar** kv = g_strsplit(*pp, "=", 2);
+
+		g_string_append(pJson, pp == options.ppSettings ? "" : ", ");
+		bench_append_json_string(pJson, kv[0]);
+		g_string_append(pJson, ": ");
+		bench_append_json_string(pJson, kv[1] ? kv[1] : "");
+		g_strfreev(kv);
+	}
+
+	g_string_append(pJson, "},\n  \"cases\": [\n");
+
+	for (gchar** ppSize = ppSizes; *ppSize && !ret; ppSize++)
+	{
+		gint width = 0, height = 0;
+
+		if (sscanf(*ppSize, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+		{
+			g_printerr("invalid size '%s'\n", *ppSize);
+			ret = 1;
+			break;
+		}
+
+		for (gchar** ppFormat = ppFormats; *ppFormat && !ret; ppFormat++)
+		{
+			GstVideoFormat eFormat = gst_video_format_from_string(*ppFormat);
+
+			if (eFormat == GST_VIDEO_FORMAT_UNKNOWN || !bench_supported_format(factory, *ppFormat))
+			{
+				g_printerr("format '%s' is not accepted by barcodereader\n", *ppFormat);
+				ret = 1;
+				break;
+			}
+
+			for (gchar** ppScene = ppScenes; *ppScene && !ret; ppScene++)
+			{
+				BenchScene eScene = BENCH_NUM_SCENES;
+				BenchCorpus corpus;
+
+				for (gint i = 0; i < BENCH_NUM_SCENES; i++)
+				{
+					if (g_str_equal(*ppScene, bench_scene_names[i]))
+						eScene = (BenchScene)i;
+				}
+
+				if (eScene == BENCH_NUM_SCENES)
+				{
+					g_printerr("unknown scene '%s'\n", *ppScene);
+					ret = 1;
+					break;
+				}
+
+				// the same seed draws the same codes in every format
+				if (!bench_corpus_init(&corpus, width, height, eFormat, eScene, (guint)options.iSeed + eScene))
+				{
+					g_printerr("cannot create %s frames of %dx%d\n", *ppFormat, width, height);
+					ret = 1;
+					break;
+				}
+
+				if (!bFirst)
+					g_string_append(pJson, ",\n");
+
+				if (!bench_run_case(&options, &corpus, pJson, &bOverBudget, &error))
+				{
+					g_printerr("%s %s %s: %s\n", *ppSize, *ppFormat, *ppScene, error ? error->message : "failed");
+					g_clear_error(&error);
+					ret = 1;
+				}
+
+				bFirst = FALSE;
+				bench_corpus_clear(&corpus);
+			}
+		}
+	}
+
+	g_string_append(pJson, "\n  ]\n}\n");
+
+	if (!ret)
+	{
+		if (options.pOutput)
+		{
+			if (!g_file_set_contents(options.pOutput, pJson->str, pJson->len, &error))
+			{
+				g_printerr("%s\n", error->message);
+				g_clear_error(&error);
+				ret = 1;
+			}
+		}
+		else
+		{
+			fputs(pJson->str, stdout);
+		}
+	}
+
+	if (!ret && bOverBudget)
+		ret = 2;
+
+	g_string_free(pJson, TRUE);
+	g_strfreev(ppSizes);
+	g_strfreev(ppFormats);
+	g_strfreev(ppScenes);
+	g_strfreev(options.ppSettings);
+	g_free(options.pSizes);
+	g_free(options.pFormats);
+	g_free(options.pScenes);
+	g_free(options.pOutput);
+	gst_object_unref(factory);
+
+	return ret;
+}
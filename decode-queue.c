@@ -0,0 +1,625 @@
+#include "decode-queue.h"
+
+
+#define DECODE_THREADS_ENV "BARCODE_READER_DECODE_THREADS"
+
+typedef struct _DecodeWorker DecodeWorker;
+typedef struct _DecodeItem DecodeItem;
+
+// anything the workers can run, either a queue of frames or a helper of a
+// parallel batch. The embedded link keeps scheduling free of allocations
+struct _DecodeItem
+{
+	void (*run) (DecodeItem* item, DecodeWorker* self);
+	GList link;
+	gboolean bQueued;		// in the ready queue of uWorker, under that worker's lock
+	guint uWorker;
+};
+
+struct _DecodeWorker
+{
+	GMutex lock;
+	GQueue ready;		// items with pending work, owner pops the head, thieves the tail
+	GThread* pThread;
+	DecodePool* pPool;
+	guint uIndex;
+};
+
+struct _DecodePool
+{
+	DecodeWorker* pWorkers;
+	guint uNumWorkers;
+	gint iNextWorker;
+
+	GMutex idleLock;
+	GCond idleCond;
+	gint iReady;
+	gboolean bShutdown;
+};
+
+struct _DecodeQueue
+{
+	DecodeItem item;
+
+	GMutex lock;
+	GCond cond;
+	GQueue jobs;
+
+	DecodeQueueFunc func;
+	GDestroyNotify jobFree;
+	gpointer pUserData;
+
+	DecodeQueuePolicy ePolicy;
+	guint uMaxJobs;
+	gboolean bBusy;
+	gboolean bScheduled;
+	gboolean bShutdown;
+
+	DecodePool* pPool;
+	guint uHomeWorker;
+};
+
+typedef struct
+{
+	DecodeItem item;
+	DecodeBatch* pBatch;
+} DecodeHelper;
+
+struct _DecodeBatch
+{
+	DecodePool* pPool;
+	DecodeHelper* pHelpers;	// one per worker, reused by every run
+
+	DecodeTaskFunc func;
+	gpointer pUserData;
+	guint uCount;
+	gint iNext;
+
+	GMutex lock;
+	GCond cond;
+	guint uDone;
+	guint uPending;			// helpers queued or running
+};
+
+G_LOCK_DEFINE_STATIC(pool);
+static DecodePool* s_pPool = NULL;
+static guint s_uPoolUsers = 0;
+static guint s_uPoolSize = 0;
+
+
+static void decode_pool_enqueue(DecodePool* pool, DecodeItem* item, guint uWorker)
+{
+	DecodeWorker* worker = &pool->pWorkers[uWorker % pool->uNumWorkers];
+
+	g_mutex_lock(&worker->lock);
+	item->link.data = item;
+	item->bQueued = TRUE;
+	item->uWorker = worker->uIndex;
+	g_queue_push_tail_link(&worker->ready, &item->link);
+	g_mutex_unlock(&worker->lock);
+
+	g_mutex_lock(&pool->idleLock);
+	pool->iReady++;
+	g_cond_signal(&pool->idleCond);
+	g_mutex_unlock(&pool->idleLock);
+}
+
+static DecodeItem* decode_worker_pop(DecodeWorker* worker, gboolean bHead)
+{
+	GList* link;
+	DecodeItem* item = NULL;
+
+	g_mutex_lock(&worker->lock);
+
+	link = bHead ? g_queue_pop_head_link(&worker->ready) : g_queue_pop_tail_link(&worker->ready);
+
+	if (link)
+	{
+		item = (DecodeItem*)link->data;
+		item->bQueued = FALSE;
+	}
+
+	g_mutex_unlock(&worker->lock);
+
+	return item;
+}
+
+static DecodeItem* decode_pool_dequeue(DecodePool* pool, DecodeWorker* self)
+{
+	DecodeItem* item = decode_worker_pop(self, TRUE);
+
+	// nothing local, steal the newest entry of another worker, its owner works
+	// through the oldest ones
+	for (guint i = 1; !item && i < pool->uNumWorkers; i++)
+		item = decode_worker_pop(&pool->pWorkers[(self->uIndex + i) % pool->uNumWorkers], FALSE);
+
+	if (item)
+	{
+		g_mutex_lock(&pool->idleLock);
+		pool->iReady--;
+		g_mutex_unlock(&pool->idleLock);
+	}
+
+	return item;
+}
+
+// runs a single job so that queues of other elements get their turn in between
+static void decode_queue_run_one(DecodeItem* item, DecodeWorker* self)
+{
+	DecodeQueue* queue = (DecodeQueue*)item;
+	GList* link;
+	gpointer job;
+	gboolean bReschedule;
+
+	g_mutex_lock(&queue->lock);
+	link = g_queue_pop_head_link(&queue->jobs);
+	job = link ? link->data : NULL;
+	queue->bBusy = job != NULL;
+	g_mutex_unlock(&queue->lock);
+
+	if (job)
+	{
+		queue->func(job, queue->pUserData);
+		queue->jobFree(job);
+	}
+
+	g_mutex_lock(&queue->lock);
+	queue->bBusy = FALSE;
+	bReschedule = !queue->bShutdown && !g_queue_is_empty(&queue->jobs);
+	queue->bScheduled = bReschedule;
+	g_cond_broadcast(&queue->cond);
+	g_mutex_unlock(&queue->lock);
+
+	if (bReschedule)
+		decode_pool_enqueue(self->pPool, &queue->item, self->uIndex);
+}
+
+// claims tasks until none are left, returns the number that were run
+static guint decode_batch_work(DecodeBatch* batch)
+{
+	guint uRun = 0;
+	gint i;
+
+	while ((i = g_atomic_int_add(&batch->iNext, 1)) < (gint)batch->uCount)
+	{
+		batch->func((guint)i, batch->pUserData);
+		uRun++;
+	}
+
+	return uRun;
+}
+
+static void decode_batch_finish(DecodeBatch* batch, guint uRun, guint uHelpers)
+{
+	g_mutex_lock(&batch->lock);
+	batch->uDone += uRun;
+	batch->uPending -= uHelpers;
+
+	if (batch->uDone == batch->uCount || batch->uPending == 0)
+		g_cond_broadcast(&batch->cond);
+
+	g_mutex_unlock(&batch->lock);
+}
+
+static void decode_helper_run(DecodeItem* item, DecodeWorker* self)
+{
+	DecodeBatch* batch = ((DecodeHelper*)item)->pBatch;
+
+	decode_batch_finish(batch, decode_batch_work(batch), 1);
+}
+
+static gpointer decode_pool_thread(gpointer data)
+{
+	DecodeWorker* self = (DecodeWorker*)data;
+	DecodePool* pool = self->pPool;
+
+	while (TRUE)
+	{
+		DecodeItem* item = decode_pool_dequeue(pool, self);
+
+		if (item)
+		{
+			item->run(item, self);
+			continue;
+		}
+
+		g_mutex_lock(&pool->idleLock);
+
+		while (!pool->bShutdown && pool->iReady <= 0)
+			g_cond_wait(&pool->idleCond, &pool->idleLock);
+
+		if (pool->bShutdown)
+		{
+			g_mutex_unlock(&pool->idleLock);
+			break;
+		}
+
+		g_mutex_unlock(&pool->idleLock);
+	}
+
+	return NULL;
+}
+
+static guint decode_pool_default_size(void)
+{
+	const gchar* pEnv = g_getenv(DECODE_THREADS_ENV);
+
+	if (pEnv)
+	{
+		guint64 uThreads = g_ascii_strtoull(pEnv, NULL, 10);
+
+		if (uThreads > 0)
+			return (guint)MIN(uThreads, 256);
+	}
+
+	return MAX(g_get_num_processors(), 1);
+}
+
+static DecodePool* decode_pool_new(guint uNumWorkers)
+{
+	DecodePool* pool = g_new0(DecodePool, 1);
+
+	g_mutex_init(&pool->idleLock);
+	g_cond_init(&pool->idleCond);
+
+	pool->uNumWorkers = uNumWorkers;
+	pool->pWorkers = g_new0(DecodeWorker, uNumWorkers);
+
+	for (guint i = 0; i < uNumWorkers; i++)
+	{
+		DecodeWorker* worker = &pool->pWorkers[i];
+
+		g_mutex_init(&worker->lock);
+		g_queue_init(&worker->ready);
+		worker->pPool = pool;
+		worker->uIndex = i;
+	}
+
+	// workers steal from each other, so start them only once all are set up
+	for (guint i = 0; i < uNumWorkers; i++)
+		pool->pWorkers[i].pThread = g_thread_new("barcode-decode", decode_pool_thread, &pool->pWorkers[i]);
+
+	return pool;
+}
+
+static void decode_pool_free(DecodePool* pool)
+{
+	g_mutex_lock(&pool->idleLock);
+	pool->bShutdown = TRUE;
+	g_cond_broadcast(&pool->idleCond);
+	g_mutex_unlock(&pool->idleLock);
+
+	// stop every thread before tearing down the queues the others steal from
+	for (guint i = 0; i < pool->uNumWorkers; i++)
+		g_thread_join(pool->pWorkers[i].pThread);
+
+	for (guint i = 0; i < pool->uNumWorkers; i++)
+	{
+		DecodeWorker* worker = &pool->pWorkers[i];
+
+		// queues and batches take their items back before releasing the pool
+		g_warn_if_fail(g_queue_is_empty(&worker->ready));
+		g_mutex_clear(&worker->lock);
+	}
+
+	g_cond_clear(&pool->idleCond);
+	g_mutex_clear(&pool->idleLock);
+	g_free(pool->pWorkers);
+	g_free(pool);
+}
+
+static DecodePool* decode_pool_acquire(guint* pHomeWorker)
+{
+	DecodePool* pool;
+
+	G_LOCK(pool);
+
+	if (!s_pPool)
+		s_pPool = decode_pool_new(s_uPoolSize > 0 ? s_uPoolSize : decode_pool_default_size());
+
+	s_uPoolUsers++;
+	pool = s_pPool;
+	*pHomeWorker = (guint)g_atomic_int_add(&pool->iNextWorker, 1) % pool->uNumWorkers;
+
+	G_UNLOCK(pool);
+
+	return pool;
+}
+
+static void decode_pool_release(void)
+{
+	DecodePool* pFree = NULL;
+
+	G_LOCK(pool);
+
+	if (--s_uPoolUsers == 0)
+	{
+		pFree = s_pPool;
+		s_pPool = NULL;
+	}
+
+	G_UNLOCK(pool);
+
+	if (pFree)
+		decode_pool_free(pFree);
+}
+
+gboolean decode_queue_set_pool_size(guint threads)
+{
+	gboolean bApplied;
+
+	G_LOCK(pool);
+	s_uPoolSize = threads;
+	bApplied = !s_pPool || s_pPool->uNumWorkers == (threads > 0 ? threads : decode_pool_default_size());
+	G_UNLOCK(pool);
+
+	return bApplied;
+}
+
+guint decode_queue_get_pool_size(void)
+{
+	guint threads;
+
+	G_LOCK(pool);
+	threads = s_uPoolSize;
+	G_UNLOCK(pool);
+
+	return threads;
+}
+
+DecodePool* decode_pool_ref(void)
+{
+	guint uHomeWorker;
+
+	return decode_pool_acquire(&uHomeWorker);
+}
+
+void decode_pool_unref(DecodePool* pool)
+{
+	g_return_if_fail(pool != NULL);
+
+	decode_pool_release();
+}
+
+// the jobs of a queue are chained through the links their owner embeds
+static void decode_queue_free_jobs(DecodeQueue* queue, GQueue* jobs)
+{
+	GList* link;
+
+	while ((link = g_queue_pop_head_link(jobs)))
+		queue->jobFree(link->data);
+}
+
+DecodeQueue* decode_queue_new(DecodeQueueFunc func, GDestroyNotify jobFree, gpointer user_data)
+{
+	DecodeQueue* queue = g_new0(DecodeQueue, 1);
+
+	queue->item.run = decode_queue_run_one;
+	g_mutex_init(&queue->lock);
+	g_cond_init(&queue->cond);
+	g_queue_init(&queue->jobs);
+
+	queue->func = func;
+	queue->jobFree = jobFree;
+	queue->pUserData = user_data;
+	queue->ePolicy = DECODE_QUEUE_POLICY_DROP_OLDEST;
+	queue->uMaxJobs = 1;
+	queue->pPool = decode_pool_acquire(&queue->uHomeWorker);
+
+	return queue;
+}
+
+void decode_queue_free(DecodeQueue* queue)
+{
+	GQueue dropped = G_QUEUE_INIT;
+
+	g_mutex_lock(&queue->lock);
+
+	queue->bShutdown = TRUE;
+
+	while (!g_queue_is_empty(&queue->jobs))
+		g_queue_push_tail_link(&dropped, g_queue_pop_head_link(&queue->jobs));
+
+	// a scheduled queue is still referenced by a worker until it has been popped
+	while (queue->bBusy || queue->bScheduled)
+		g_cond_wait(&queue->cond, &queue->lock);
+
+	g_mutex_unlock(&queue->lock);
+
+	decode_queue_free_jobs(queue, &dropped);
+
+	decode_pool_release();
+
+	g_cond_clear(&queue->cond);
+	g_mutex_clear(&queue->lock);
+	g_free(queue);
+}
+
+void decode_queue_set_policy(DecodeQueue* queue, DecodeQueuePolicy policy, guint maxJobs)
+{
+	g_mutex_lock(&queue->lock);
+	queue->ePolicy = policy;
+	queue->uMaxJobs = MAX(maxJobs, 1);
+	g_mutex_unlock(&queue->lock);
+}
+
+gboolean decode_queue_push(DecodeQueue* queue, gpointer job, GList* link)
+{
+	GQueue dropped = G_QUEUE_INIT;
+	gboolean bAccepted = TRUE;
+	gboolean bSchedule = FALSE;
+
+	link->data = job;
+	link->prev = link->next = NULL;
+
+	g_mutex_lock(&queue->lock);
+
+	switch (queue->ePolicy)
+	{
+	case DECODE_QUEUE_POLICY_DROP_NEWEST:
+		bAccepted = !queue->bBusy && g_queue_is_empty(&queue->jobs);
+		break;
+
+	case DECODE_QUEUE_POLICY_DROP_OLDEST:
+		while (!g_queue_is_empty(&queue->jobs))
+			g_queue_push_tail_link(&dropped, g_queue_pop_head_link(&queue->jobs));
+		break;
+
+	case DECODE_QUEUE_POLICY_QUEUE:
+		bAccepted = g_queue_get_length(&queue->jobs) < queue->uMaxJobs;
+		break;
+	}
+
+	bAccepted = bAccepted && !queue->bShutdown;
+
+	if (bAccepted)
+	{
+		g_queue_push_tail_link(&queue->jobs, link);
+
+		if (!queue->bScheduled)
+		{
+			queue->bScheduled = TRUE;
+			bSchedule = TRUE;
+		}
+	}
+	else
+	{
+		g_queue_push_tail_link(&dropped, link);
+	}
+
+	g_mutex_unlock(&queue->lock);
+
+	if (bSchedule)
+		decode_pool_enqueue(queue->pPool, &queue->item, queue->uHomeWorker);
+
+	// free dropped frames outside the lock so the worker is never held up
+	decode_queue_free_jobs(queue, &dropped);
+
+	return bAccepted;
+}
+
+void decode_queue_flush(DecodeQueue* queue)
+{
+	GQueue dropped = G_QUEUE_INIT;
+
+	g_mutex_lock(&queue->lock);
+
+	while (!g_queue_is_empty(&queue->jobs))
+		g_queue_push_tail_link(&dropped, g_queue_pop_head_link(&queue->jobs));
+
+	while (queue->bBusy)
+		g_cond_wait(&queue->cond, &queue->lock);
+
+	g_mutex_unlock(&queue->lock);
+
+	decode_queue_free_jobs(queue, &dropped);
+}
+
+DecodeBatch* decode_batch_new(DecodePool* pool)
+{
+	DecodeBatch* batch = g_new0(DecodeBatch, 1);
+
+	G_LOCK(pool);
+	s_uPoolUsers++;
+	G_UNLOCK(pool);
+
+	batch->pPool = pool;
+	batch->pHelpers = g_new0(DecodeHelper, pool->uNumWorkers);
+
+	for (guint i = 0; i < pool->uNumWorkers; i++)
+	{
+		batch->pHelpers[i].item.run = decode_helper_run;
+		batch->pHelpers[i].pBatch = batch;
+	}
+
+	g_mutex_init(&batch->lock);
+	g_cond_init(&batch->cond);
+
+	return batch;
+}
+
+void decode_batch_free(DecodeBatch* batch)
+{
+	g_cond_clear(&batch->cond);
+	g_mutex_clear(&batch->lock);
+	g_free(batch->pHelpers);
+	g_free(batch);
+
+	decode_pool_release();
+}
+
+void decode_batch_run(DecodeBatch* batch, guint count, DecodeTaskFunc func, gpointer user_data)
+{
+	DecodePool* pool = batch->pPool;
+
+	if (count == 0)
+		return;
+
+	if (count == 1)
+	{
+		func(0, user_data);
+		return;
+	}
+
+	// spread the helpers of concurrent batches over the workers
+	guint uHomeWorker = (guint)g_atomic_int_add(&pool->iNextWorker, 1);
+	guint uHelpers = MIN(count - 1, pool->uNumWorkers);
+	guint uTaken = 0;
+
+	batch->func = func;
+	batch->pUserData = user_data;
+	batch->uCount = count;
+	batch->iNext = 0;
+	batch->uDone = 0;
+	batch->uPending = uHelpers;
+
+	for (guint i = 0; i < uHelpers; i++)
+		decode_pool_enqueue(pool, &batch->pHelpers[i].item, uHomeWorker + i);
+
+	// the caller works as well, so this can't starve when called from a pool thread
+	decode_batch_finish(batch, decode_batch_work(batch), 0);
+
+	g_mutex_lock(&batch->lock);
+
+	while (batch->uDone < batch->uCount)
+		g_cond_wait(&batch->cond, &batch->lock);
+
+	g_mutex_unlock(&batch->lock);
+
+	// helpers nobody got to are taken back, the batch is reused by the next run
+	for (guint i = 0; i < uHelpers; i++)
+	{
+		DecodeItem* item = &batch->pHelpers[i].item;
+		DecodeWorker* worker = &pool->pWorkers[item->uWorker];
+		gboolean bTaken = FALSE;
+
+		g_mutex_lock(&worker->lock);
+
+		if (item->bQueued)
+		{
+			g_queue_unlink(&worker->ready, &item->link);
+			item->bQueued = FALSE;
+			bTaken = TRUE;
+		}
+
+		g_mutex_unlock(&worker->lock);
+
+		if (bTaken)
+		{
+			g_mutex_lock(&pool->idleLock);
+			pool->iReady--;
+			g_mutex_unlock(&pool->idleLock);
+			uTaken++;
+		}
+	}
+
+	// and the ones that were popped are waited for
+	g_mutex_lock(&batch->lock);
+
+	batch->uPending -= uTaken;
+
+	while (batch->uPending > 0)
+		g_cond_wait(&batch->cond, &batch->lock);
+
+	g_mutex_unlock(&batch->lock);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <gst/gst.h>
+
+
+typedef enum
+{
+	DECODE_QUEUE_POLICY_DROP_NEWEST,	// drop incoming frames while the worker is busy
+	DECODE_QUEUE_POLICY_DROP_OLDEST,	// keep only the most recent pending frame
+	DECODE_QUEUE_POLICY_QUEUE,			// queue up to max-jobs frames, drop the rest
+} DecodeQueuePolicy;
+
+typedef struct _DecodeQueue DecodeQueue;
+typedef struct _DecodePool DecodePool;
+typedef struct _DecodeBatch DecodeBatch;
+
+typedef void (*DecodeQueueFunc) (gpointer job, gpointer user_data);
+typedef void (*DecodeTaskFunc) (guint index, gpointer user_data);
+
+// process-wide number of decode threads shared by all queues, 0 picks the
+// BARCODE_READER_DECODE_THREADS environment variable or the number of CPUs.
+// Returns FALSE when a pool with a different size is running, the new size
+// then only applies once every user has released it. Only queues are bounded
+// by the pool, a batch runs on its caller's thread as well
+gboolean decode_queue_set_pool_size(guint threads);
+guint decode_queue_get_pool_size(void);
+
+// keeps the shared pool and its threads alive until the reference is dropped,
+// starting the pool is expensive so hold on to it rather than per call
+DecodePool* decode_pool_ref(void);
+void decode_pool_unref(DecodePool* pool);
+
+DecodeQueue* decode_queue_new(DecodeQueueFunc func, GDestroyNotify jobFree, gpointer user_data);
+void decode_queue_free(DecodeQueue* queue);
+void decode_queue_set_policy(DecodeQueue* queue, DecodeQueuePolicy policy, guint maxJobs);
+// link is embedded in the job and holds it while it is queued, so pushing
+// allocates nothing. It must stay valid until jobFree has been called
+gboolean decode_queue_push(DecodeQueue* queue, gpointer job, GList* link);
+void decode_queue_flush(DecodeQueue* queue);
+
+// reusable state of parallel runs on pool, keeps the pool referenced. A batch
+// serves one caller at a time
+DecodeBatch* decode_batch_new(DecodePool* pool);
+void decode_batch_free(DecodeBatch* batch);
+
+// runs func for every index in 0..count-1 on the pool and the calling thread,
+// returns once all of them have completed and no worker refers to the batch
+void decode_batch_run(DecodeBatch* batch, guint count, DecodeTaskFunc func, gpointer user_data);
@@ -0,0 +1,362 @@
+#include "luma.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LUMA_USE_SSE2
+#include <emmintrin.h>
+// MSVC has no SSSE3 switch, /arch:AVX implies it
+#if defined(__SSSE3__) || defined(__AVX__)
+#define LUMA_USE_SSSE3
+#include <tmmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define LUMA_USE_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define LUMA_USE_NEON
+#include <arm_neon.h>
+#endif
+
+// ZXing's RGBToLum weights, in 1/1024
+#define LUMA_R 306
+#define LUMA_G 601
+#define LUMA_B 117
+
+
+void luma_plane_reserve(LumaPlane* plane, gint width, gint height)
+{
+	gint stride = (width + LUMA_PLANE_ALIGN - 1) & ~(LUMA_PLANE_ALIGN - 1);
+
+	if (plane->pAlloc && plane->width == width && plane->height == height)
+		return;
+
+	g_free(plane->pAlloc);
+	plane->pAlloc = g_malloc((gsize)stride * height + LUMA_PLANE_ALIGN - 1);
+	plane->pData = (guint8*)(((guintptr)plane->pAlloc + LUMA_PLANE_ALIGN - 1) & ~(guintptr)(LUMA_PLANE_ALIGN - 1));
+	plane->stride = stride;
+	plane->width = width;
+	plane->height = height;
+}
+
+void luma_plane_clear(LumaPlane* plane)
+{
+	g_free(plane->pAlloc);
+	memset(plane, 0, sizeof(*plane));
+}
+
+// 2x2 box filter of packed 8 bit rows, may run in place (pDst == pSrc)
+static void luma_halve_packed(const guint8* pSrc, gint srcStride, guint8* pDst, gint dstStride, gint dstWidth, gint dstHeight)
+{
+	for (gint y = 0; y < dstHeight; y++)
+	{
+		const guint8* pRow0 = pSrc + (gsize)(2 * y) * srcStride;
+		const guint8* pRow1 = pRow0 + srcStride;
+		guint8* pOut = pDst + (gsize)y * dstStride;
+		gint x = 0;
+
+#if defined(LUMA_USE_SSE2)
+		const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+
+		for (; x + 16 <= dstWidth; x += 16)
+		{
+			__m128i v0 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(pRow0 + 2 * x)), _mm_loadu_si128((const __m128i*)(pRow1 + 2 * x)));
+			__m128i v1 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(pRow0 + 2 * x + 16)), _mm_loadu_si128((const __m128i*)(pRow1 + 2 * x + 16)));
+			__m128i h0 = _mm_avg_epu16(_mm_and_si128(v0, lowBytes), _mm_srli_epi16(v0, 8));
+			__m128i h1 = _mm_avg_epu16(_mm_and_si128(v1, lowBytes), _mm_srli_epi16(v1, 8));
+
+			_mm_storeu_si128((__m128i*)(pOut + x), _mm_packus_epi16(h0, h1));
+		}
+#elif defined(LUMA_USE_NEON)
+		for (; x + 16 <= dstWidth; x += 16)
+		{
+			uint8x16x2_t r0 = vld2q_u8(pRow0 + 2 * x);
+			uint8x16x2_t r1 = vld2q_u8(pRow1 + 2 * x);
+
+			vst1q_u8(pOut + x, vrhaddq_u8(vrhaddq_u8(r0.val[0], r0.val[1]), vrhaddq_u8(r1.val[0], r1.val[1])));
+		}
+#endif
+
+		for (; x < dstWidth; x++)
+			pOut[x] = (guint8)((pRow0[2 * x] + pRow0[2 * x + 1] + pRow1[2 * x] + pRow1[2 * x + 1] + 2) >> 2);
+	}
+}
+
+// first 2x2 step, picks the luma bytes out of interleaved pixels
+static void luma_halve_strided(const guint8* pSrc, gint rowStride, gint pixStride, gint lumaOffset, guint8* pDst, gint dstStride, gint dstWidth, gint dstHeight)
+{
+	for (gint y = 0; y < dstHeight; y++)
+	{
+		const guint8* pRow0 = pSrc + (gsize)(2 * y) * rowStride + lumaOffset;
+		const guint8* pRow1 = pRow0 + rowStride;
+		guint8* pOut = pDst + (gsize)y * dstStride;
+
+		for (gint x = 0; x < dstWidth; x++)
+		{
+			gint x0 = 2 * x * pixStride;
+			gint x1 = x0 + pixStride;
+
+			pOut[x] = (guint8)((pRow0[x0] + pRow0[x1] + pRow1[x0] + pRow1[x1] + 2) >> 2);
+		}
+	}
+}
+
+void luma_downscale(const guint8* pSrc, gint width, gint height, gint rowStride, gint pixStride, gint lumaOffset,
+	guint factor, guint8* pDst, gint dstStride, guint8* pTmp)
+{
+	gint w = width / 2;
+	gint h = height / 2;
+
+	g_return_if_fail(factor >= 2);
+	g_return_if_fail(factor < 4 || pTmp != NULL);
+
+	// pDst is only sized for the last octave, the ones before it need their own
+	// rows of w bytes
+	guint8* pOut = factor >= 4 ? pTmp : pDst;
+	gint outStride = factor >= 4 ? w : dstStride;
+
+	if (pixStride == 1)
+		luma_halve_packed(pSrc + lumaOffset, rowStride, pOut, outStride, w, h);
+	else
+		luma_halve_strided(pSrc, rowStride, pixStride, lumaOffset, pOut, outStride, w, h);
+
+	// the octaves in between shrink pTmp in place, the last one packs into pDst
+	for (factor >>= 1; factor >= 2; factor >>= 1)
+	{
+		w /= 2;
+		h /= 2;
+
+		if (factor == 2)
+			luma_halve_packed(pOut, outStride, pDst, dstStride, w, h);
+		else
+			luma_halve_packed(pOut, outStride, pOut, outStride, w, h);
+	}
+}
+
+void luma_extract_v210(const guint8* pSrc, gint width, gint height, gint rowStride, guint8* pDst, gint dstStride)
+{
+	for (gint y = 0; y < height; y++)
+	{
+		const guint8* pRow = pSrc + (gsize)y * rowStride;
+		guint8* pOut = pDst + (gsize)y * dstStride;
+		gint x = 0;
+
+		// 6 pixels in four little endian words: U Y V, Y U Y, V Y U, Y V Y
+		for (; x + 6 <= width; x += 6, pRow += 16)
+		{
+			guint32 w1 = GST_READ_UINT32_LE(pRow + 4);
+			guint32 w3 = GST_READ_UINT32_LE(pRow + 12);
+
+			pOut[x + 0] = (guint8)(GST_READ_UINT32_LE(pRow) >> 12);
+			pOut[x + 1] = (guint8)(w1 >> 2);
+			pOut[x + 2] = (guint8)(w1 >> 22);
+			pOut[x + 3] = (guint8)(GST_READ_UINT32_LE(pRow + 8) >> 12);
+			pOut[x + 4] = (guint8)(w3 >> 2);
+			pOut[x + 5] = (guint8)(w3 >> 22);
+		}
+
+		// the last group of a row is only partially used
+		for (gint i = 0; x < width; x++, i++)
+		{
+			static const guint8 word[6] = { 0, 1, 1, 2, 3, 3 };
+			static const guint8 shift[6] = { 12, 2, 22, 12, 2, 22 };
+
+			pOut[x] = (guint8)(GST_READ_UINT32_LE(pRow + 4 * word[i]) >> shift[i]);
+		}
+	}
+}
+
+void luma_copy(const guint8* pSrc, gint width, gint height, gint rowStride, gint pixStride, guint8* pDst, gint dstStride)
+{
+	for (gint y = 0; y < height; y++)
+	{
+		const guint8* pRow = pSrc + (gsize)y * rowStride;
+		guint8* pOut = pDst + (gsize)y * dstStride;
+
+		if (pixStride == 1)
+		{
+			memcpy(pOut, pRow, width);
+			continue;
+		}
+
+		for (gint x = 0; x < width; x++)
+			pOut[x] = pRow[(gsize)x * pixStride];
+	}
+}
+
+#if defined(LUMA_USE_NEON)
+static inline uint8x8_t luma_rgb_neon(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+	uint16x8_t r16 = vmovl_u8(r);
+	uint16x8_t g16 = vmovl_u8(g);
+	uint16x8_t b16 = vmovl_u8(b);
+	uint32x4_t lo = vmull_n_u16(vget_low_u16(r16), LUMA_R);
+	uint32x4_t hi = vmull_n_u16(vget_high_u16(r16), LUMA_R);
+
+	lo = vmlal_n_u16(lo, vget_low_u16(g16), LUMA_G);
+	hi = vmlal_n_u16(hi, vget_high_u16(g16), LUMA_G);
+	lo = vmlal_n_u16(lo, vget_low_u16(b16), LUMA_B);
+	hi = vmlal_n_u16(hi, vget_high_u16(b16), LUMA_B);
+
+	// the rounding shift adds the same 0x200 as the scalar path
+	return vmovn_u16(vcombine_u16(vrshrn_n_u32(lo, 10), vrshrn_n_u32(hi, 10)));
+}
+#endif
+
+#if defined(LUMA_USE_SSE2)
+// 4 pixels of 3 bytes spread to 4 bytes each, the 4th byte gets a zero weight.
+// Reads up to 16 bytes from p
+static inline __m128i luma_load_rgb_sse2(const guint8* p)
+{
+#if defined(LUMA_USE_SSSE3)
+	return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p),
+		_mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+#else
+	guint32 v[4];
+
+	memcpy(&v[0], p, 4);
+	memcpy(&v[1], p + 3, 4);
+	memcpy(&v[2], p + 6, 4);
+	memcpy(&v[3], p + 9, 4);
+
+	return _mm_setr_epi32((int)v[0], (int)v[1], (int)v[2], (int)v[3]);
+#endif
+}
+
+// luma of 4 pixels of 4 bytes as 32 bit lanes
+static inline __m128i luma_quad_sse2(__m128i px, __m128i weights)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	// widen to 16 bits, the multiply-add leaves two partial sums per pixel
+	__m128 lo = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(px, zero), weights));
+	__m128 hi = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(px, zero), weights));
+	__m128i even = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i odd = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+
+	return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(even, odd), _mm_set1_epi32(0x200)), 10);
+}
+#endif
+
+#if defined(LUMA_USE_AVX2)
+// the same for 8 pixels, reads up to 28 bytes from p for 3 byte pixels
+static inline __m256i luma_load_avx2(const guint8* p, gint pixStride)
+{
+	if (pixStride == 4)
+		return _mm256_loadu_si256((const __m256i*)p);
+
+	const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+	return _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(
+		_mm_loadu_si128((const __m128i*)p)), _mm_loadu_si128((const __m128i*)(p + 12)), 1), spread);
+}
+
+static inline __m256i luma_octet_avx2(__m256i px, __m256i weights)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256 lo = _mm256_castsi256_ps(_mm256_madd_epi16(_mm256_unpacklo_epi8(px, zero), weights));
+	__m256 hi = _mm256_castsi256_ps(_mm256_madd_epi16(_mm256_unpackhi_epi8(px, zero), weights));
+	__m256i even = _mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m256i odd = _mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+
+	return _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(even, odd), _mm256_set1_epi32(0x200)), 10);
+}
+#endif
+
+static void luma_from_rgb_row(const guint8* pRow, gint width, gint pixStride, gint rOffset, gint gOffset, gint bOffset, guint8* pOut)
+{
+	gint x = 0;
+
+#if defined(LUMA_USE_SSE2)
+	gint16 w[4] = { 0 };
+
+	w[rOffset] = LUMA_R;
+	w[gOffset] = LUMA_G;
+	w[bOffset] = LUMA_B;
+
+	// 3 byte pixels are loaded in 16 byte steps, stop early enough not to read past the row
+	gint over = pixStride == 3 ? 2 : 0;
+#endif
+
+#if defined(LUMA_USE_AVX2)
+	if (pixStride == 3 || pixStride == 4)
+	{
+		const __m256i weights = _mm256_setr_epi16(w[0], w[1], w[2], w[3], w[0], w[1], w[2], w[3],
+			w[0], w[1], w[2], w[3], w[0], w[1], w[2], w[3]);
+
+		for (; x + 32 + over <= width; x += 32)
+		{
+			__m256i sums[4];
+
+			for (int i = 0; i < 4; i++)
+				sums[i] = luma_octet_avx2(luma_load_avx2(pRow + (gsize)(x + 8 * i) * pixStride, pixStride), weights);
+
+			// packing works within 128 bit lanes, put the groups of 4 pixels back in order
+			__m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(sums[0], sums[1]), _mm256_packs_epi32(sums[2], sums[3]));
+
+			_mm256_storeu_si256((__m256i*)(pOut + x),
+				_mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)));
+		}
+	}
+#endif
+
+#if defined(LUMA_USE_SSE2)
+	if (pixStride == 3 || pixStride == 4)
+	{
+		const __m128i weights = _mm_setr_epi16(w[0], w[1], w[2], w[3], w[0], w[1], w[2], w[3]);
+
+		for (; x + 16 + over <= width; x += 16)
+		{
+			__m128i sums[4];
+
+			for (int i = 0; i < 4; i++)
+			{
+				const guint8* p = pRow + (gsize)(x + 4 * i) * pixStride;
+
+				sums[i] = luma_quad_sse2(pixStride == 4 ? _mm_loadu_si128((const __m128i*)p) : luma_load_rgb_sse2(p), weights);
+			}
+
+			_mm_storeu_si128((__m128i*)(pOut + x),
+				_mm_packus_epi16(_mm_packs_epi32(sums[0], sums[1]), _mm_packs_epi32(sums[2], sums[3])));
+		}
+	}
+#elif defined(LUMA_USE_NEON)
+	if (pixStride == 4)
+	{
+		for (; x + 16 <= width; x += 16)
+		{
+			uint8x16x4_t px = vld4q_u8(pRow + 4 * x);
+
+			vst1q_u8(pOut + x, vcombine_u8(
+				luma_rgb_neon(vget_low_u8(px.val[rOffset]), vget_low_u8(px.val[gOffset]), vget_low_u8(px.val[bOffset])),
+				luma_rgb_neon(vget_high_u8(px.val[rOffset]), vget_high_u8(px.val[gOffset]), vget_high_u8(px.val[bOffset]))));
+		}
+	}
+	else if (pixStride == 3)
+	{
+		for (; x + 16 <= width; x += 16)
+		{
+			uint8x16x3_t px = vld3q_u8(pRow + 3 * x);
+
+			vst1q_u8(pOut + x, vcombine_u8(
+				luma_rgb_neon(vget_low_u8(px.val[rOffset]), vget_low_u8(px.val[gOffset]), vget_low_u8(px.val[bOffset])),
+				luma_rgb_neon(vget_high_u8(px.val[rOffset]), vget_high_u8(px.val[gOffset]), vget_high_u8(px.val[bOffset]))));
+		}
+	}
+#endif
+
+	for (; x < width; x++)
+	{
+		const guint8* p = pRow + x * pixStride;
+
+		pOut[x] = (guint8)((LUMA_R * p[rOffset] + LUMA_G * p[gOffset] + LUMA_B * p[bOffset] + 0x200) >> 10);
+	}
+}
+
+void luma_from_rgb(const guint8* pSrc, gint width, gint height, gint rowStride, gint pixStride,
+	gint rOffset, gint gOffset, gint bOffset, guint8* pDst, gint dstStride)
+{
+	for (gint y = 0; y < height; y++)
+		luma_from_rgb_row(pSrc + (gsize)y * rowStride, width, pixStride, rOffset, gOffset, bOffset, pDst + (gsize)y * dstStride);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <gst/gst.h>
+
+
+// 8 bit luma copy of a frame, rows start on LUMA_PLANE_ALIGN byte boundaries
+#define LUMA_PLANE_ALIGN 64
+
+typedef struct
+{
+	guint8* pData;
+	gint stride;
+	gint width;
+	gint height;
+	gpointer pAlloc;
+} LumaPlane;
+
+// resizes plane for width x height, keeps the allocation when the size is unchanged
+void luma_plane_reserve(LumaPlane* plane, gint width, gint height);
+void luma_plane_clear(LumaPlane* plane);
+
+// box filters the luma of an image down by factor >= 2, rounded down to a
+// power of two, into pDst. The luma byte of each source pixel is at lumaOffset
+// within its pixStride bytes. pDst needs room for (height / factor) rows of
+// dstStride >= width / factor bytes. For factor >= 4 the intermediate octaves
+// go to pTmp, which needs (width / 2) * (height / 2) bytes
+void luma_downscale(const guint8* pSrc, gint width, gint height, gint rowStride, gint pixStride, gint lumaOffset,
+	guint factor, guint8* pDst, gint dstStride, guint8* pTmp);
+
+// unpacks the 8 most significant bits of every v210 luma sample into pDst,
+// dstStride >= width
+void luma_extract_v210(const guint8* pSrc, gint width, gint height, gint rowStride, guint8* pDst, gint dstStride);
+
+// copies luma bytes that are pixStride apart into pDst, dstStride >= width
+void luma_copy(const guint8* pSrc, gint width, gint height, gint rowStride, gint pixStride, guint8* pDst, gint dstStride);
+
+// converts packed RGB with the given channel offsets within pixStride bytes
+// into luma, weighted the same way ZXing does it
+void luma_from_rgb(const guint8* pSrc, gint width, gint height, gint rowStride, gint pixStride,
+	gint rOffset, gint gOffset, gint bOffset, guint8* pDst, gint dstStride);
@@ -0,0 +1,199 @@
+#include "motion.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MOTION_USE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MOTION_USE_NEON
+#include <arm_neon.h>
+#endif
+
+
+#define MOTION_CELL_SIZE 8		// frame pixels per signature cell side
+#define MOTION_TILE_CELLS 16	// signature cells per tile side, a tile row is one 128 bit register
+#define MOTION_TILE_SIZE (MOTION_CELL_SIZE * MOTION_TILE_CELLS)
+
+struct _MotionGate
+{
+	guint8* pCurrent;
+	guint8* pReference;
+	guint8* pChanged;
+
+	gint iWidth;
+	gint iHeight;
+	gint iCellsX;		// padded to whole tiles, the padding stays zero
+	gint iCellsY;
+	gint iTilesX;
+	gint iTilesY;
+
+	gboolean bHasReference;
+};
+
+
+MotionGate* motion_gate_new(void)
+{
+	return g_new0(MotionGate, 1);
+}
+
+void motion_gate_free(MotionGate* gate)
+{
+	g_free(gate->pCurrent);
+	g_free(gate->pReference);
+	g_free(gate->pChanged);
+	g_free(gate);
+}
+
+void motion_gate_reset(MotionGate* gate)
+{
+	gate->bHasReference = FALSE;
+}
+
+static void motion_gate_resize(MotionGate* gate, gint width, gint height)
+{
+	if (gate->iWidth == width && gate->iHeight == height)
+		return;
+
+	gate->iWidth = width;
+	gate->iHeight = height;
+	gate->iTilesX = (width + MOTION_TILE_SIZE - 1) / MOTION_TILE_SIZE;
+	gate->iTilesY = (height + MOTION_TILE_SIZE - 1) / MOTION_TILE_SIZE;
+	gate->iCellsX = gate->iTilesX * MOTION_TILE_CELLS;
+	gate->iCellsY = gate->iTilesY * MOTION_TILE_CELLS;
+
+	g_free(gate->pCurrent);
+	g_free(gate->pReference);
+	g_free(gate->pChanged);
+
+	gate->pCurrent = g_malloc0(gate->iCellsX * gate->iCellsY);
+	gate->pReference = g_malloc0(gate->iCellsX * gate->iCellsY);
+	gate->pChanged = g_malloc0(gate->iTilesX * gate->iTilesY);
+	gate->bHasReference = FALSE;
+}
+
+void motion_gate_update(MotionGate* gate, const guint8* pImage, gint width, gint height, gint rowStride, gint pixStride, gint lumaOffset)
+{
+	motion_gate_resize(gate, width, height);
+
+	gint cellsX = (width + MOTION_CELL_SIZE - 1) / MOTION_CELL_SIZE;
+	gint cellsY = (height + MOTION_CELL_SIZE - 1) / MOTION_CELL_SIZE;
+
+	// 2x2 samples per cell are plenty to notice anything the size of a barcode moving
+	for (gint cy = 0; cy < cellsY; cy++)
+	{
+		gint y0 = MIN(cy * MOTION_CELL_SIZE + 2, height - 1);
+		gint y1 = MIN(cy * MOTION_CELL_SIZE + 6, height - 1);
+		const guint8* pRow0 = pImage + (gsize)y0 * rowStride + lumaOffset;
+		const guint8* pRow1 = pImage + (gsize)y1 * rowStride + lumaOffset;
+		guint8* pCell = gate->pCurrent + cy * gate->iCellsX;
+
+		for (gint cx = 0; cx < cellsX; cx++)
+		{
+			gint x0 = MIN(cx * MOTION_CELL_SIZE + 2, width - 1) * pixStride;
+			gint x1 = MIN(cx * MOTION_CELL_SIZE + 6, width - 1) * pixStride;
+
+			pCell[cx] = (guint8)((pRow0[x0] + pRow0[x1] + pRow1[x0] + pRow1[x1] + 2) >> 2);
+		}
+	}
+}
+
+static guint motion_tile_sad(const guint8* a, const guint8* b, gint stride)
+{
+#if defined(MOTION_USE_SSE2)
+	__m128i acc = _mm_setzero_si128();
+
+	for (gint i = 0; i < MOTION_TILE_CELLS; i++, a += stride, b += stride)
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b)));
+
+	return (guint)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#elif defined(MOTION_USE_NEON)
+	uint16x8_t acc = vdupq_n_u16(0);
+
+	for (gint i = 0; i < MOTION_TILE_CELLS; i++, a += stride, b += stride)
+		acc = vpadalq_u8(acc, vabdq_u8(vld1q_u8(a), vld1q_u8(b)));
+
+	uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(acc));
+
+	return (guint)(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+#else
+	guint sad = 0;
+
+	for (gint i = 0; i < MOTION_TILE_CELLS; i++, a += stride, b += stride)
+		for (gint j = 0; j < MOTION_TILE_CELLS; j++)
+			sad += (guint)ABS(a[j] - b[j]);
+
+	return sad;
+#endif
+}
+
+guint motion_gate_compare(MotionGate* gate, guint threshold)
+{
+	guint uChanged = 0;
+
+	for (gint ty = 0; ty < gate->iTilesY; ty++)
+	{
+		for (gint tx = 0; tx < gate->iTilesX; tx++)
+		{
+			gsize offset = (gsize)ty * MOTION_TILE_CELLS * gate->iCellsX + tx * MOTION_TILE_CELLS;
+			gboolean bChanged = TRUE;
+
+			if (gate->bHasReference)
+			{
+				guint sad = motion_tile_sad(gate->pCurrent + offset, gate->pReference + offset, gate->iCellsX);
+				bChanged = sad >= threshold * MOTION_TILE_CELLS * MOTION_TILE_CELLS;
+			}
+
+			gate->pChanged[ty * gate->iTilesX + tx] = (guint8)bChanged;
+			uChanged += bChanged;
+		}
+	}
+
+	return uChanged;
+}
+
+gboolean motion_gate_clip_to_changes(MotionGate* gate, gint* x, gint* y, gint* width, gint* height)
+{
+	gint tx0 = *x / MOTION_TILE_SIZE;
+	gint ty0 = *y / MOTION_TILE_SIZE;
+	gint tx1 = MIN((*x + *width - 1) / MOTION_TILE_SIZE, gate->iTilesX - 1);
+	gint ty1 = MIN((*y + *height - 1) / MOTION_TILE_SIZE, gate->iTilesY - 1);
+	gint minX = G_MAXINT, minY = G_MAXINT, maxX = -1, maxY = -1;
+
+	for (gint ty = ty0; ty <= ty1; ty++)
+	{
+		for (gint tx = tx0; tx <= tx1; tx++)
+		{
+			if (!gate->pChanged[ty * gate->iTilesX + tx])
+				continue;
+
+			minX = MIN(minX, tx);
+			minY = MIN(minY, ty);
+			maxX = MAX(maxX, tx);
+			maxY = MAX(maxY, ty);
+		}
+	}
+
+	if (maxX < 0)
+		return FALSE;
+
+	// the margin catches codes that straddle a tile border or just moved out of a tile
+	gint left = MAX((minX - 1) * MOTION_TILE_SIZE, *x);
+	gint top = MAX((minY - 1) * MOTION_TILE_SIZE, *y);
+	gint right = MIN((maxX + 2) * MOTION_TILE_SIZE, *x + *width);
+	gint bottom = MIN((maxY + 2) * MOTION_TILE_SIZE, *y + *height);
+
+	*x = left;
+	*y = top;
+	*width = right - left;
+	*height = bottom - top;
+
+	return TRUE;
+}
+
+void motion_gate_commit(MotionGate* gate)
+{
+	guint8* pTmp = gate->pReference;
+
+	gate->pReference = gate->pCurrent;
+	gate->pCurrent = pTmp;
+	gate->bHasReference = TRUE;
+}
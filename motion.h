@@ -0,0 +1,26 @@
+#pragma once
+
+#include <gst/gst.h>
+
+
+typedef struct _MotionGate MotionGate;
+
+MotionGate* motion_gate_new(void);
+void motion_gate_free(MotionGate* gate);
+void motion_gate_reset(MotionGate* gate);
+
+// samples a downscaled luma signature of the frame, the luma byte of each
+// pixel is at lumaOffset within its pixStride bytes
+void motion_gate_update(MotionGate* gate, const guint8* pImage, gint width, gint height, gint rowStride, gint pixStride, gint lumaOffset);
+
+// compares the signature against the last committed one and returns the
+// number of tiles whose mean difference reaches threshold, all tiles count
+// as changed while there is nothing to compare against
+guint motion_gate_compare(MotionGate* gate, guint threshold);
+
+// shrinks the rectangle to the changed tiles within it plus a one tile
+// margin, returns FALSE when nothing changed inside of it
+gboolean motion_gate_clip_to_changes(MotionGate* gate, gint* x, gint* y, gint* width, gint* height);
+
+// makes the last signature the reference for the next comparisons
+void motion_gate_commit(MotionGate* gate);
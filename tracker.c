@@ -0,0 +1,166 @@
+#include "tracker.h"
+
+
+#define TRACKER_MIN_MARGIN 16	// pixels of quiet zone kept around a code at the least
+#define TRACKER_SMOOTHING 0.5	// weight of the latest measurement in the velocity
+
+typedef struct
+{
+	const gchar* format;	// interned
+	gchar* text;
+
+	gdouble dCenterX;
+	gdouble dCenterY;
+	gdouble dWidth;
+	gdouble dHeight;
+	gdouble dVelocityX;		// pixels per nanosecond
+	gdouble dVelocityY;
+
+	GstClockTime lastSeen;
+	guint uMisses;
+} BarcodeTrack;
+
+struct _BarcodeTracker
+{
+	GHashTable* pTracks;
+};
+
+
+static guint barcode_track_hash(gconstpointer key)
+{
+	const BarcodeTrack* track = (const BarcodeTrack*)key;
+
+	return g_str_hash(track->text) ^ g_direct_hash(track->format);
+}
+
+static gboolean barcode_track_equal(gconstpointer a, gconstpointer b)
+{
+	const BarcodeTrack* ta = (const BarcodeTrack*)a;
+	const BarcodeTrack* tb = (const BarcodeTrack*)b;
+
+	return ta->format == tb->format && g_str_equal(ta->text, tb->text);
+}
+
+static void barcode_track_free(gpointer data)
+{
+	BarcodeTrack* track = (BarcodeTrack*)data;
+
+	g_free(track->text);
+	g_free(track);
+}
+
+BarcodeTracker* barcode_tracker_new(void)
+{
+	BarcodeTracker* tracker = g_new0(BarcodeTracker, 1);
+
+	tracker->pTracks = g_hash_table_new_full(barcode_track_hash, barcode_track_equal, barcode_track_free, NULL);
+
+	return tracker;
+}
+
+void barcode_tracker_free(BarcodeTracker* tracker)
+{
+	g_hash_table_unref(tracker->pTracks);
+	g_free(tracker);
+}
+
+void barcode_tracker_reset(BarcodeTracker* tracker)
+{
+	g_hash_table_remove_all(tracker->pTracks);
+}
+
+guint barcode_tracker_size(BarcodeTracker* tracker)
+{
+	return g_hash_table_size(tracker->pTracks);
+}
+
+void barcode_tracker_update(BarcodeTracker* tracker, const gchar* format, const gchar* text, const ZXing_Position* position, GstClockTime timestamp)
+{
+	BarcodeTrack key;
+	BarcodeTrack* track;
+	gint minX = MIN(MIN(position->topLeft.x, position->topRight.x), MIN(position->bottomRight.x, position->bottomLeft.x));
+	gint maxX = MAX(MAX(position->topLeft.x, position->topRight.x), MAX(position->bottomRight.x, position->bottomLeft.x));
+	gint minY = MIN(MIN(position->topLeft.y, position->topRight.y), MIN(position->bottomRight.y, position->bottomLeft.y));
+	gint maxY = MAX(MAX(position->topLeft.y, position->topRight.y), MAX(position->bottomRight.y, position->bottomLeft.y));
+	gdouble dCenterX = (minX + maxX) / 2.0;
+	gdouble dCenterY = (minY + maxY) / 2.0;
+
+	key.format = g_intern_string(format);
+	key.text = (gchar*)text;
+
+	track = (BarcodeTrack*)g_hash_table_lookup(tracker->pTracks, &key);
+
+	if (!track)
+	{
+		track = g_new0(BarcodeTrack, 1);
+		track->format = key.format;
+		track->text = g_strdup(text);
+		g_hash_table_add(tracker->pTracks, track);
+	}
+	else if (timestamp > track->lastSeen)
+	{
+		gdouble dt = (gdouble)(timestamp - track->lastSeen);
+
+		track->dVelocityX += TRACKER_SMOOTHING * ((dCenterX - track->dCenterX) / dt - track->dVelocityX);
+		track->dVelocityY += TRACKER_SMOOTHING * ((dCenterY - track->dCenterY) / dt - track->dVelocityY);
+	}
+
+	track->dCenterX = dCenterX;
+	track->dCenterY = dCenterY;
+	track->dWidth = maxX - minX + 1;
+	track->dHeight = maxY - minY + 1;
+	track->lastSeen = timestamp;
+	track->uMisses = 0;
+}
+
+guint barcode_tracker_expire(BarcodeTracker* tracker, GstClockTime timestamp, guint maxMisses)
+{
+	GHashTableIter iter;
+	gpointer key;
+	guint uMissed = 0;
+
+	g_hash_table_iter_init(&iter, tracker->pTracks);
+
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+	{
+		BarcodeTrack* track = (BarcodeTrack*)key;
+
+		if (track->lastSeen == timestamp)
+			continue;
+
+		uMissed++;
+
+		if (++track->uMisses > maxMisses)
+			g_hash_table_iter_remove(&iter);
+	}
+
+	return uMissed;
+}
+
+void barcode_tracker_predict(BarcodeTracker* tracker, GstClockTime timestamp, BarcodeTrackerRegionFunc func, gpointer user_data)
+{
+	GHashTableIter iter;
+	gpointer key;
+
+	g_hash_table_iter_init(&iter, tracker->pTracks);
+
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+	{
+		BarcodeTrack* track = (BarcodeTrack*)key;
+		gdouble dt = timestamp > track->lastSeen ? (gdouble)(timestamp - track->lastSeen) : 0;
+		gdouble dCenterX = track->dCenterX + track->dVelocityX * dt;
+		gdouble dCenterY = track->dCenterY + track->dVelocityY * dt;
+
+		// half a code of slack in every direction covers rotation and prediction error
+		gdouble dMargin = MAX(MAX(track->dWidth, track->dHeight) / 2, TRACKER_MIN_MARGIN);
+		gdouble dHalfWidth = track->dWidth / 2 + dMargin;
+		gdouble dHalfHeight = track->dHeight / 2 + dMargin;
+
+		func(
+			(gint)(dCenterX - dHalfWidth),
+			(gint)(dCenterY - dHalfHeight),
+			(gint)(2 * dHalfWidth),
+			(gint)(2 * dHalfHeight),
+			user_data);
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <ZXing/ZXingC.h>
+
+
+typedef struct _BarcodeTracker BarcodeTracker;
+
+typedef void (*BarcodeTrackerRegionFunc) (gint x, gint y, gint width, gint height, gpointer user_data);
+
+BarcodeTracker* barcode_tracker_new(void);
+void barcode_tracker_free(BarcodeTracker* tracker);
+void barcode_tracker_reset(BarcodeTracker* tracker);
+guint barcode_tracker_size(BarcodeTracker* tracker);
+
+// records where a code was seen in the frame at timestamp
+void barcode_tracker_update(BarcodeTracker* tracker, const gchar* format, const gchar* text, const ZXing_Position* position, GstClockTime timestamp);
+
+// counts a miss for every track that was not seen at timestamp and drops the
+// ones missed more than maxMisses times in a row, returns the number missed
+guint barcode_tracker_expire(BarcodeTracker* tracker, GstClockTime timestamp, guint maxMisses);
+
+// calls func with a search window around the predicted position of every track
+void barcode_tracker_predict(BarcodeTracker* tracker, GstClockTime timestamp, BarcodeTrackerRegionFunc func, gpointer user_data);
@@ -1,196 +1,416 @@
 #include "utils.h"
+#include <string.h>
 
 
-typedef struct RGB_Pixel
+#define YUV_RED_Y 76
+#define YUV_RED_U 85
+#define YUV_RED_V 255
+
+#define PIXEL_ROW(frame, y) ((guint8*)GST_VIDEO_FRAME_PLANE_DATA(frame, 0) + (y) * GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0))
+#define COMP_ROW(frame, comp, y) ((guint8*)GST_VIDEO_FRAME_COMP_DATA(frame, comp) + (y) * GST_VIDEO_FRAME_COMP_STRIDE(frame, comp))
+
+// alpha runs from 0 to 256 (opaque)
+#define BLEND(dst, value, alpha) ((dst) + ((((gint)(value) - (gint)(dst)) * (gint)(alpha)) >> 8))
+#define OPAQUE 256
+
+typedef struct
 {
-	guint8 values[3];
-} RGB_Pixel;
+	gint x0;
+	gint y0;
+	gint x1;
+	gint y1;
+} OverlaySegment;
 
-typedef struct RGBA_Pixel
+typedef struct
+{
+	gint x;
+	gint y;
+	gint width;
+	gint height;
+	guint alpha;
+} OverlayBox;
+
+typedef struct
 {
-	guint8 values[4];
-} RGBA_Pixel;
+	gint y;
+	gint x0;
+	gint x1;
+	guint alpha;
+} OverlaySpan;
 
-typedef struct YUY2_Pixel
+// fills all spans, they are already clipped to the frame
+typedef void (*OverlayRenderFunc) (GstVideoFrame* frame, const OverlaySpan* pSpans, guint count);
+
+struct _Overlay
 {
-	guint8 luma;
-	guint8 chroma;
-} YUY2_Pixel;
+	GArray* pSegments;
+	GArray* pBoxes;
+	GArray* pSpans;		// scratch of overlay_render, kept to avoid reallocating
+	gint thickness;
+	OverlayRenderFunc render;	// specialized for the negotiated format
+};
+
+
+#define DEFINE_RGB_SPAN(name, bpp, r, g, b) \
+static inline void render_span_##name(GstVideoFrame* frame, gint y, gint x0, gint x1, guint alpha) \
+{ \
+	guint8* p = PIXEL_ROW(frame, y) + x0 * (bpp); \
+ \
+	for (gint x = x0; x <= x1; x++, p += (bpp)) \
+	{ \
+		p[r] = (guint8)BLEND(p[r], 255, alpha); \
+		p[g] = (guint8)BLEND(p[g], 0, alpha); \
+		p[b] = (guint8)BLEND(p[b], 0, alpha); \
+	} \
+}
+
+DEFINE_RGB_SPAN(bgrx, 4, 2, 1, 0)
+DEFINE_RGB_SPAN(xrgb, 4, 1, 2, 3)
+DEFINE_RGB_SPAN(xbgr, 4, 3, 2, 1)
+DEFINE_RGB_SPAN(rgbx, 4, 0, 1, 2)
+DEFINE_RGB_SPAN(rgb, 3, 0, 1, 2)
+DEFINE_RGB_SPAN(bgr, 3, 2, 1, 0)
+
+// planar, semi-planar and packed 8 bit YUV, chroma is shared by the
+// neighbouring pixels of the subsampled block
+#define DEFINE_YUV_SPAN(name, lumaPixStride, chromaPixStride, wSub, hSub) \
+static inline void render_span_##name(GstVideoFrame* frame, gint y, gint x0, gint x1, guint alpha) \
+{ \
+	guint8* pY = COMP_ROW(frame, GST_VIDEO_COMP_Y, y); \
+	guint8* pU = COMP_ROW(frame, GST_VIDEO_COMP_U, y >> (hSub)); \
+	guint8* pV = COMP_ROW(frame, GST_VIDEO_COMP_V, y >> (hSub)); \
+ \
+	for (gint x = x0; x <= x1; x++) \
+		pY[x * (lumaPixStride)] = (guint8)BLEND(pY[x * (lumaPixStride)], YUV_RED_Y, alpha); \
+ \
+	/* blend shared chroma rows only once */ \
+	if (alpha < OPAQUE && (y & ((1 << (hSub)) - 1))) \
+		return; \
+ \
+	for (gint x = x0 >> (wSub); x <= x1 >> (wSub); x++) \
+	{ \
+		pU[x * (chromaPixStride)] = (guint8)BLEND(pU[x * (chromaPixStride)], YUV_RED_U, alpha); \
+		pV[x * (chromaPixStride)] = (guint8)BLEND(pV[x * (chromaPixStride)], YUV_RED_V, alpha); \
+	} \
+}
 
-#define BGR_RED ((RGB_Pixel){0, 0, 255})
-#define RGB_RED ((RGB_Pixel){255, 0, 0})
-#define BGRA_RED ((RGBA_Pixel){0, 0, 255, })
-#define YUY2_RED_0 ((YUY2_Pixel){76, 85})
-#define YUY2_RED_1 ((YUY2_Pixel){76, 255})
+DEFINE_YUV_SPAN(packed422, 2, 4, 1, 0)
+DEFINE_YUV_SPAN(semiplanar420, 1, 2, 1, 1)
+DEFINE_YUV_SPAN(semiplanar422, 1, 2, 1, 0)
+DEFINE_YUV_SPAN(planar420, 1, 1, 1, 1)
+
+static inline void render_span_gray8(GstVideoFrame* frame, gint y, gint x0, gint x1, guint alpha)
+{
+	guint8* p = PIXEL_ROW(frame, y);
+
+	if (alpha >= OPAQUE)
+	{
+		memset(p + x0, 255, x1 - x0 + 1);
+		return;
+	}
+
+	for (gint x = x0; x <= x1; x++)
+		p[x] = (guint8)BLEND(p[x], 255, alpha);
+}
 
-// function pointer to hold pixel setting function
-void (*set_pixel) (guint8* image, int width, int height, int x, int y) = NULL;
+#define DEFINE_GRAY16_SPAN(name, READ, WRITE) \
+static inline void render_span_##name(GstVideoFrame* frame, gint y, gint x0, gint x1, guint alpha) \
+{ \
+	guint8* p = PIXEL_ROW(frame, y); \
+ \
+	for (gint x = x0; x <= x1; x++) \
+		WRITE(p + 2 * x, (guint16)BLEND(READ(p + 2 * x), 0xFFFF, alpha)); \
+}
 
+DEFINE_GRAY16_SPAN(gray16le, GST_READ_UINT16_LE, GST_WRITE_UINT16_LE)
+DEFINE_GRAY16_SPAN(gray16be, GST_READ_UINT16_BE, GST_WRITE_UINT16_BE)
 
-static void set_pixel_bgrx(guint8* image, int width, int height, int x, int y)
+// P010 keeps its 10 bits in the top of little endian 16 bit samples
+static inline void blend_sample16(guint8* p, guint value, guint alpha)
 {
-	((guint32*)image)[y * width + x] = 0x00FF0000;
+	GST_WRITE_UINT16_LE(p, (guint16)BLEND(GST_READ_UINT16_LE(p), value, alpha));
 }
 
-static void set_pixel_bgra(guint8* image, int width, int height, int x, int y)
+static inline void render_span_p010(GstVideoFrame* frame, gint y, gint x0, gint x1, guint alpha)
 {
-	image[(y * width + x) * 4 + 0] = 0;
-	image[(y * width + x) * 4 + 1] = 0;
-	image[(y * width + x) * 4 + 2] = 255;
+	guint8* pY = COMP_ROW(frame, GST_VIDEO_COMP_Y, y);
+	guint8* pU = COMP_ROW(frame, GST_VIDEO_COMP_U, y >> 1);
+	guint8* pV = COMP_ROW(frame, GST_VIDEO_COMP_V, y >> 1);
+
+	for (gint x = x0; x <= x1; x++)
+		blend_sample16(pY + 2 * x, YUV_RED_Y << 8, alpha);
+
+	if (alpha < OPAQUE && (y & 1))
+		return;
+
+	for (gint x = x0 >> 1; x <= x1 >> 1; x++)
+	{
+		blend_sample16(pU + 4 * x, YUV_RED_U << 8, alpha);
+		blend_sample16(pV + 4 * x, YUV_RED_V << 8, alpha);
+	}
 }
 
-static void set_pixel_xrgb(guint8* image, int width, int height, int x, int y)
+static inline void blend_v210_sample(guint8* group, gint word, gint shift, guint value, guint alpha)
 {
-	((guint32*)image)[y * width + x] = 0x0000FF00;
+	guint32 v = GST_READ_UINT32_LE(group + 4 * word);
+	guint sample = (v >> shift) & 0x3FF;
+
+	sample = (guint)BLEND(sample, value, alpha);
+	GST_WRITE_UINT32_LE(group + 4 * word, (v & ~(0x3FFu << shift)) | (sample << shift));
 }
 
-static void set_pixel_argb(guint8* image, int width, int height, int x, int y)
+// v210 packs 6 pixels into 4 words: U0 Y0 V0, Y1 U2 Y2, V2 Y3 U4, Y4 V4 Y5
+static inline void render_span_v210(GstVideoFrame* frame, gint y, gint x0, gint x1, guint alpha)
 {
-	image[(y * width + x) * 4 + 1] = 255;
-	image[(y * width + x) * 4 + 2] = 0;
-	image[(y * width + x) * 4 + 3] = 0;
+	static const guint8 lumaWord[6] = { 0, 1, 1, 2, 3, 3 };
+	static const guint8 lumaShift[6] = { 10, 0, 20, 10, 0, 20 };
+	static const guint8 chromaWord[3][2] = { { 0, 0 }, { 1, 2 }, { 2, 3 } };
+	static const guint8 chromaShift[3][2] = { { 0, 20 }, { 10, 0 }, { 20, 10 } };
+	guint8* p = PIXEL_ROW(frame, y);
+
+	for (gint x = x0; x <= x1; x++)
+	{
+		guint8* group = p + (x / 6) * 16;
+		gint i = x % 6;
+
+		blend_v210_sample(group, lumaWord[i], lumaShift[i], YUV_RED_Y << 2, alpha);
+
+		// once per pixel pair
+		if ((i & 1) == 0 || x == x0)
+		{
+			blend_v210_sample(group, chromaWord[i / 2][0], chromaShift[i / 2][0], YUV_RED_U << 2, alpha);
+			blend_v210_sample(group, chromaWord[i / 2][1], chromaShift[i / 2][1], YUV_RED_V << 2, alpha);
+		}
+	}
 }
 
-static void set_pixel_xbgr(guint8* image, int width, int height, int x, int y)
+// one loop per format with the pixel writes inlined, the only indirect call is per frame
+#define DEFINE_RENDER(name) \
+static void render_##name(GstVideoFrame* frame, const OverlaySpan* pSpans, guint count) \
+{ \
+	for (guint i = 0; i < count; i++) \
+		render_span_##name(frame, pSpans[i].y, pSpans[i].x0, pSpans[i].x1, pSpans[i].alpha); \
+}
+
+DEFINE_RENDER(bgrx)
+DEFINE_RENDER(xrgb)
+DEFINE_RENDER(xbgr)
+DEFINE_RENDER(rgbx)
+DEFINE_RENDER(rgb)
+DEFINE_RENDER(bgr)
+DEFINE_RENDER(packed422)
+DEFINE_RENDER(semiplanar420)
+DEFINE_RENDER(semiplanar422)
+DEFINE_RENDER(planar420)
+DEFINE_RENDER(gray8)
+DEFINE_RENDER(gray16le)
+DEFINE_RENDER(gray16be)
+DEFINE_RENDER(p010)
+DEFINE_RENDER(v210)
+
+Overlay* overlay_new(void)
 {
-	((guint32*)image)[y * width + x] = 0xFF000000;
+	Overlay* overlay = g_new0(Overlay, 1);
+
+	overlay->pSegments = g_array_new(FALSE, FALSE, sizeof(OverlaySegment));
+	overlay->pBoxes = g_array_new(FALSE, FALSE, sizeof(OverlayBox));
+	overlay->pSpans = g_array_new(FALSE, FALSE, sizeof(OverlaySpan));
+	overlay->thickness = 1;
+
+	return overlay;
 }
 
-static void set_pixel_abgr(guint8* image, int width, int height, int x, int y)
+void overlay_free(Overlay* overlay)
 {
-	image[(y * width + x) * 4 + 1] = 0;
-	image[(y * width + x) * 4 + 2] = 0;
-	image[(y * width + x) * 4 + 3] = 255;
+	g_array_unref(overlay->pSegments);
+	g_array_unref(overlay->pBoxes);
+	g_array_unref(overlay->pSpans);
+	g_free(overlay);
 }
 
-static void set_pixel_rgbx(guint8* image, int width, int height, int x, int y)
+void overlay_set_thickness(Overlay* overlay, guint thickness)
 {
-	((guint32*)image)[y * width + x] = 0x000000FF;
+	overlay->thickness = MAX(thickness, 1);
 }
 
-static void set_pixel_rgba(guint8* image, int width, int height, int x, int y)
+static void draw_line(Overlay* overlay, gint x0, gint y0, gint x1, gint y1)
 {
-	image[(y * width + x) * 4 + 0] = 255;
-	image[(y * width + x) * 4 + 1] = 0;
-	image[(y * width + x) * 4 + 2] = 0;
+	OverlaySegment segment = { x0, y0, x1, y1 };
+
+	g_array_append_val(overlay->pSegments, segment);
 }
 
-static void set_pixel_bgr(guint8* image, int width, int height, int x, int y)
+void draw_quad(Overlay* overlay, ZXing_Position position)
 {
-	((RGB_Pixel*)image)[y * width + x] = BGR_RED;
+	draw_line(overlay, position.topLeft.x, position.topLeft.y, position.topRight.x, position.topRight.y);
+	draw_line(overlay, position.topLeft.x, position.topLeft.y, position.bottomLeft.x, position.bottomLeft.y);
+	draw_line(overlay, position.topRight.x, position.topRight.y, position.bottomRight.x, position.bottomRight.y);
+	draw_line(overlay, position.bottomLeft.x, position.bottomLeft.y, position.bottomRight.x, position.bottomRight.y);
 }
 
-static void set_pixel_rgb(guint8* image, int width, int height, int x, int y)
+void draw_column(Overlay* overlay, guint startX, guint endX, guint height)
 {
-	((RGB_Pixel*)image)[y * width + x] = RGB_RED;
+	draw_line(overlay, startX, 0, startX, (gint)height - 1);
+	draw_line(overlay, endX, 0, endX, (gint)height - 1);
 }
 
-static void set_pixel_gray8(guint8* image, int width, int height, int x, int y)
+void draw_box(Overlay* overlay, gint x, gint y, gint width, gint height, guint8 alpha)
 {
-	image[y * width + x] = 255;
+	// 255 maps to fully opaque
+	OverlayBox box = { x, y, width, height, alpha + (alpha >> 7) };
+
+	g_array_append_val(overlay->pBoxes, box);
 }
 
-static void set_pixel_yuy2(guint8* image, int width, int height, int x, int y)
+static void add_span(GArray* pSpans, gint y, gint x0, gint x1, guint alpha, gint width)
 {
-	if (x % 2 ==0)
-		((YUY2_Pixel*)image)[y * width + x] = YUY2_RED_0;
-	else
-		((YUY2_Pixel*)image)[y * width + x] = YUY2_RED_1;
+	OverlaySpan span = { y, MAX(x0, 0), MIN(x1, width - 1), alpha };
+
+	if (span.x0 <= span.x1)
+		g_array_append_val(pSpans, span);
 }
 
-static void draw_line(guint8* image, int width, int height, int x0, int y0, int x1, int y1)
+// rasterizes the segment swept by a thickness x thickness brush into row spans
+static void add_segment_spans(Overlay* overlay, const OverlaySegment* segment, gint width, gint height)
 {
-    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
-    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
-    int err = dx + dy, e2;
+	gint h0 = (overlay->thickness - 1) / 2;
+	gint h1 = overlay->thickness - 1 - h0;
+	gint x0 = segment->x0, y0 = segment->y0, x1 = segment->x1, y1 = segment->y1;
+
+	if (y0 > y1)
+	{
+		x0 = segment->x1;
+		y0 = segment->y1;
+		x1 = segment->x0;
+		y1 = segment->y0;
+	}
 
-	if (x0 >= width || x1 >= width || y0 >= height || y1 >= height)
-		return;
+	gint dx = x1 - x0;
+	gint dy = y1 - y0;
+
+	for (gint y = MAX(y0 - h0, 0); y <= MIN(y1 + h1, height - 1); y++)
+	{
+		// the centre rows whose brush reaches this row, each covering half a row up and down
+		gint ya = MAX(y0, y - h1);
+		gint yb = MIN(y1, y + h0);
+		gint xa = x0;
+		gint xb = x1;
+
+		if (dy != 0)
+		{
+			xa = x0 + (gint)((gint64)MAX(2 * (ya - y0) - 1, 0) * dx / (2 * dy));
+			xb = x0 + (gint)((gint64)MIN(2 * (yb - y0) + 1, 2 * dy) * dx / (2 * dy));
+		}
 
-    while (1) 
-    {
-		if (set_pixel)
-			set_pixel(image, width, height, x0, y0);
-        
-        if (x0 == x1 && y0 == y1) break;
-        e2 = 2 * err;
-        if (e2 >= dy) { err += dy; x0 += sx; }
-        if (e2 <= dx) { err += dx; y0 += sy; }
-    }
+		add_span(overlay->pSpans, y, MIN(xa, xb) - h0, MAX(xa, xb) + h1, OPAQUE, width);
+	}
 }
 
-void draw_quad(guint8* image, int width, int height, ZXing_Position position)
+static gint compare_spans(gconstpointer a, gconstpointer b)
 {
-    // Draw lines between the points
-    draw_line(image, width, height, position.topLeft.x, position.topLeft.y, position.topRight.x, position.topRight.y);
-	draw_line(image, width, height, position.topLeft.x, position.topLeft.y, position.bottomLeft.x, position.bottomLeft.y);
-	draw_line(image, width, height, position.topRight.x, position.topRight.y, position.bottomRight.x, position.bottomRight.y);
-	draw_line(image, width, height, position.bottomLeft.x, position.bottomLeft.y, position.bottomRight.x, position.bottomRight.y);
+	return ((const OverlaySpan*)a)->y - ((const OverlaySpan*)b)->y;
 }
 
-void draw_column(guint8* image, int width, int height, guint startX, guint endX)
+void overlay_render(Overlay* overlay, GstVideoFrame* frame)
 {
-	draw_line(image, width, height, startX, 0, startX, height - 1);
-	draw_line(image, width, height, endX, 0, endX, height - 1);
+	gint width = GST_VIDEO_FRAME_WIDTH(frame);
+	gint height = GST_VIDEO_FRAME_HEIGHT(frame);
+
+	if (overlay->render)
+	{
+		for (guint i = 0; i < overlay->pBoxes->len; i++)
+		{
+			const OverlayBox* box = &g_array_index(overlay->pBoxes, OverlayBox, i);
+
+			for (gint y = MAX(box->y, 0); y < MIN(box->y + box->height, height); y++)
+				add_span(overlay->pSpans, y, box->x, box->x + box->width - 1, box->alpha, width);
+		}
+
+		for (guint i = 0; i < overlay->pSegments->len; i++)
+			add_segment_spans(overlay, &g_array_index(overlay->pSegments, OverlaySegment, i), width, height);
+
+		// one top to bottom sweep over the frame
+		g_array_sort(overlay->pSpans, compare_spans);
+		overlay->render(frame, (const OverlaySpan*)overlay->pSpans->data, overlay->pSpans->len);
+	}
+
+	g_array_set_size(overlay->pSegments, 0);
+	g_array_set_size(overlay->pBoxes, 0);
+	g_array_set_size(overlay->pSpans, 0);
 }
 
-void utils_init(GstVideoFormat format)
+void overlay_set_format(Overlay* overlay, GstVideoFormat format)
 {
 	switch (format) {
 	case GST_VIDEO_FORMAT_BGRx:
-		set_pixel = set_pixel_bgrx;
-		break;
-
 	case GST_VIDEO_FORMAT_BGRA:
-		set_pixel = set_pixel_bgra;
+		overlay->render = render_bgrx;
 		break;
 
 	case GST_VIDEO_FORMAT_ARGB:
-		set_pixel = set_pixel_argb;
-		break;
-	
 	case GST_VIDEO_FORMAT_xRGB:
-		set_pixel = set_pixel_xrgb;
+		overlay->render = render_xrgb;
 		break;
 
 	case GST_VIDEO_FORMAT_ABGR:
-		set_pixel = set_pixel_abgr;
-		break;
-	
 	case GST_VIDEO_FORMAT_xBGR:
-		set_pixel = set_pixel_xbgr;
+		overlay->render = render_xbgr;
 		break;
 
 	case GST_VIDEO_FORMAT_RGBA:
-		set_pixel = set_pixel_rgba;
-		break;
-	
 	case GST_VIDEO_FORMAT_RGBx:
-		set_pixel = set_pixel_rgbx;
+		overlay->render = render_rgbx;
 		break;
 
 	case GST_VIDEO_FORMAT_RGB:
-		set_pixel = set_pixel_rgb;
+		overlay->render = render_rgb;
 		break;
 
 	case GST_VIDEO_FORMAT_BGR:
-		set_pixel = set_pixel_bgr;
+		overlay->render = render_bgr;
 		break;
 
 	case GST_VIDEO_FORMAT_YUY2:
-		set_pixel = set_pixel_yuy2;
+	case GST_VIDEO_FORMAT_UYVY:
+		overlay->render = render_packed422;
 		break;
 
 	case GST_VIDEO_FORMAT_NV12:
 	case GST_VIDEO_FORMAT_NV21:
+		overlay->render = render_semiplanar420;
+		break;
+
+	case GST_VIDEO_FORMAT_NV16:
+		overlay->render = render_semiplanar422;
+		break;
+
 	case GST_VIDEO_FORMAT_YV12:
 	case GST_VIDEO_FORMAT_I420:
+		overlay->render = render_planar420;
+		break;
+
+	case GST_VIDEO_FORMAT_P010_10LE:
+		overlay->render = render_p010;
+		break;
+
+	case GST_VIDEO_FORMAT_v210:
+		overlay->render = render_v210;
+		break;
+
 	case GST_VIDEO_FORMAT_GRAY8:
-		set_pixel = set_pixel_gray8;
+		overlay->render = render_gray8;
+		break;
+
+	case GST_VIDEO_FORMAT_GRAY16_LE:
+		overlay->render = render_gray16le;
+		break;
+
+	case GST_VIDEO_FORMAT_GRAY16_BE:
+		overlay->render = render_gray16be;
 		break;
 
 	default:
-		set_pixel = NULL;
+		overlay->render = NULL;
 		break;
 	}
 }
@@ -5,6 +5,15 @@
 #include <ZXing/ZXingC.h>
 
 
-void utils_init(GstVideoFormat format);
-void draw_quad(guint8* image, int width, int height, ZXing_Position position);
-void draw_column(guint8* image, int width, int height, guint startX, guint endX);
\ No newline at end of file
+// overlay primitives collected over a frame and rasterized together by overlay_render
+typedef struct _Overlay Overlay;
+
+Overlay* overlay_new(void);
+void overlay_free(Overlay* overlay);
+// picks the renderer for frames of format, nothing is drawn for unsupported formats
+void overlay_set_format(Overlay* overlay, GstVideoFormat format);
+void overlay_set_thickness(Overlay* overlay, guint thickness);
+void draw_quad(Overlay* overlay, ZXing_Position position);
+void draw_column(Overlay* overlay, guint startX, guint endX, guint height);
+void draw_box(Overlay* overlay, gint x, gint y, gint width, gint height, guint8 alpha);
+void overlay_render(Overlay* overlay, GstVideoFrame* frame);
\ No newline at end of file